@@ -0,0 +1,66 @@
+/**********************************************************************
+
+Arduino.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Host stand-in for the Arduino core. Time comes from a virtual clock
+  that the simulator advances, and pin levels come from a table the
+  simulator can set, so the sketch runs deterministically on a PC.
+
+**********************************************************************/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+////////////////////////////
+//  ARDUINO CORE TYPES    //
+////////////////////////////
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define LOW           0
+#define HIGH          1
+
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+
+#define F(string)     (string)                                        //  No separate flash address space on the host
+
+#define PROGMEM
+#define pgm_read_byte( addr )               ( *(const uint8_t *)( addr ) )
+#define memcpy_P( dest, src, size )         memcpy( ( dest ), ( src ), ( size ) )
+
+#define SIM_NUM_PINS  64
+
+//////////////////////
+//  VIRTUAL CLOCK   //
+//////////////////////
+
+uint32_t simMicros = 0;                                               //  Virtual time in microseconds, advanced only by the simulator and delay()
+uint8_t  simPinLevel[ SIM_NUM_PINS ];                                 //  Level returned by digitalRead() for each pin
+
+inline uint32_t micros()                      { return simMicros; }
+inline uint32_t millis()                      { return simMicros / 1000; }
+inline void     delay( uint32_t ms )          { simMicros += ms * 1000; }
+inline void     delayMicroseconds( uint16_t us ) { simMicros += us; }
+
+inline void pinMode( uint8_t pin, uint8_t mode )
+{
+  if( mode == INPUT_PULLUP )
+  {
+    simPinLevel[pin] = HIGH;                                          //  Pull-up holds an unconnected input high
+  }
+}
+
+inline int  digitalRead( uint8_t pin )                { return simPinLevel[pin]; }
+inline void digitalWrite( uint8_t pin, uint8_t val )  { simPinLevel[pin] = val; }
+
+#endif
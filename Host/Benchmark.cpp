@@ -0,0 +1,219 @@
+/**********************************************************************
+
+Benchmark.cpp
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Drives every head through a repeating series of aspect changes on the
+  virtual clock while background DCC traffic flows, and reports:
+
+    - host time spent in each pass of loop() ( mean, 99th percentile
+      and worst case ), to compare the cost of code changes
+    - output channel writes per pass of loop(), and with the mock
+      output backend the number of frames committed
+    - per head, the number of curve keyframes reached, how many were
+      skipped to catch up, the worst-case time from when a keyframe was
+      due to when loop() got to it, and the mean and longest time from
+      sending an aspect to the head coming to rest, all in virtual
+      time, to catch timing regressions in the vane animation
+    - the decoder's own performance counters, read back through the
+      same CVs a command station would read ( CVs 112-127 )
+    - the number of signal packets sent, to compare per-head addressing
+      with mast mode
+
+    usage: benchmark [-s seconds] [-l loop cost us] [-r repeat ms] [-p packet gap ms] [-m]
+
+      -s  virtual seconds to run ( default 60 )
+      -l  virtual time charged per pass of loop() ( default 100 us )
+      -r  also repeat each head's current aspect every N ms ( default off )
+      -p  gap between background idle packets ( default 6 ms )
+      -m  mast mode: one packet to the base address sets the first
+          heads together, using the factory default mast table
+
+**********************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+
+#include "HostSim.h"
+
+#define ASPECT_CHANGE_MS 2000                                         //  Time between aspect changes on each head
+
+const uint8_t aspectSequence[] = { 2, 3, 0, 5, 1, 8, 3, 4, 2, 0, 7, 6 };
+
+struct FrameStats
+{
+  uint32_t frames;                                                    //  Keyframes reached
+  uint32_t skipped;                                                   //  Keyframes passed over in one step to catch up
+  uint32_t worstLate;                                                 //  Longest a keyframe waited for loop(), in microseconds
+  uint16_t lastFrameStart;
+  bool     waiting;                                                   //  Aspect sent and the head has not come to rest yet
+  bool     moved;                                                     //  Head has animated since the aspect was sent
+  uint32_t sentAt;                                                    //  Virtual time the aspect was sent, in microseconds
+  uint32_t transitions;
+  double   transitionTotal;                                           //  Sum of the send-to-rest times, in microseconds
+  uint32_t worstTransition;
+};
+
+int main( int argc, char ** argv )
+{
+  uint32_t seconds = 60;
+  uint32_t repeatMs = 0;
+  uint32_t packetGapMs = 6;
+  bool     mast = false;
+  int opt;
+
+  while( ( opt = getopt( argc, argv, "s:l:r:p:m" ) ) != -1 )
+  {
+    switch( opt )
+    {
+      case 's': seconds = atoi( optarg ); break;
+      case 'l': simLoopCostUs = atoi( optarg ); break;
+      case 'r': repeatMs = atoi( optarg ); break;
+      case 'p': packetGapMs = atoi( optarg ); break;
+      case 'm': mast = true; break;
+      default:
+        fprintf( stderr, "usage: %s [-s seconds] [-l loop cost us] [-r repeat ms] [-p packet gap ms] [-m]\n", argv[0] );
+        return 1;
+    }
+  }
+
+  simBoot();
+  if( mast )
+  {
+    simWriteCV( CV_MAST_MODE, 1 );
+  }
+  uint8_t firstHead = mast ? MAST_HEADS : 0;                          //  First head that still takes packets at its own address
+
+  FrameStats stats[ NUM_HEADS ] = {};
+  uint8_t    currentAspect[ NUM_HEADS ] = {};
+  std::vector< uint32_t > loopNanos;
+  loopNanos.reserve( (size_t)seconds * 1000000 / simLoopCostUs + 1 );
+
+  uint32_t start = millis();
+  uint32_t nextChange = start;
+  uint32_t nextPacket = start;
+  uint32_t nextRepeat = start;
+  uint32_t changeIndex = 0;
+  uint32_t writesAtStart = simOutputWrites;
+  uint32_t signalPackets = 0;
+
+  while( millis() - start < seconds * 1000 )
+  {
+    uint32_t now = millis();
+
+    if( (int32_t)( now - nextChange ) >= 0 )                          //  Step every head to its next aspect, offset so they differ
+    {
+      for( uint8_t headIndex = 0; headIndex < NUM_HEADS; headIndex++ )
+      {
+        uint8_t offset = ( headIndex < firstHead ) ? 0 : headIndex;   //  Mast heads all follow the mast aspect, which the default table gives every head
+        currentAspect[headIndex] = aspectSequence[ ( changeIndex + offset * 4 ) % sizeof( aspectSequence ) ];
+        if( headIndex >= firstHead )
+        {
+          simSendAspect( headIndex, currentAspect[headIndex] );
+          signalPackets++;
+        }
+        stats[headIndex].waiting = true;
+        stats[headIndex].moved = false;
+        stats[headIndex].sentAt = simMicros;
+      }
+      if( mast )
+      {
+        simSendMastAspect( currentAspect[0] );
+        signalPackets++;
+      }
+      changeIndex++;
+      nextChange += ASPECT_CHANGE_MS;
+    }
+    if( repeatMs && (int32_t)( now - nextRepeat ) >= 0 )              //  Command station refresh of the aspects already sent
+    {
+      for( uint8_t headIndex = firstHead; headIndex < NUM_HEADS; headIndex++ )
+      {
+        simSendAspect( headIndex, currentAspect[headIndex] );
+        signalPackets++;
+      }
+      if( mast )
+      {
+        simSendMastAspect( currentAspect[0] );
+        signalPackets++;
+      }
+      nextRepeat += repeatMs;
+    }
+    if( packetGapMs && (int32_t)( now - nextPacket ) >= 0 )
+    {
+      simQueuePacket( simIdlePacket() );
+      nextPacket += packetGapMs;
+    }
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    loop();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    loopNanos.push_back( std::chrono::duration_cast< std::chrono::nanoseconds >( t1 - t0 ).count() );
+    simMicros += simLoopCostUs;
+
+    uint32_t passStart = simMicros - simLoopCostUs;                   //  Virtual time at which this pass of loop() started
+    for( uint8_t headIndex = 0; headIndex < NUM_HEADS; headIndex++ )
+    {
+      FrameStats & s = stats[headIndex];
+      byte status = heads.headStatus(headIndex);
+      bool animating = ( status == STATE_ANIMATE ) || ( status == STATE_ANIMATE_BLACK );
+      uint16_t frameStart = heads.frameStart[headIndex];
+      if( animating && ( frameStart != s.lastFrameStart ) )         //  Each keyframe reached moves frameStart on by ANIMATE_DELAY_TIME
+      {
+        int16_t lateMs = (uint16_t)( passStart / 1000 ) - frameStart;
+        if( lateMs >= 0 )                                             //  Not the start of a stabilize window, which is in the future
+        {
+          uint16_t steps = (uint16_t)( frameStart - s.lastFrameStart ) / ANIMATE_DELAY_TIME;
+          s.frames += steps;
+          s.skipped += steps > 1 ? steps - 1 : 0;
+          s.worstLate = std::max( s.worstLate, (uint32_t)lateMs * 1000 + passStart % 1000 );
+        }
+      }
+      s.lastFrameStart = frameStart;
+      s.moved |= animating;
+      if( s.waiting && s.moved && ( status == STATE_IDLE ) )
+      {
+        uint32_t transition = passStart - s.sentAt;
+        s.waiting = false;
+        s.transitions++;
+        s.transitionTotal += transition;
+        s.worstTransition = std::max( s.worstTransition, transition );
+      }
+    }
+  }
+
+  std::vector< uint32_t > sorted( loopNanos );
+  std::sort( sorted.begin(), sorted.end() );
+  double total = 0;
+  for( size_t i = 0; i < loopNanos.size(); i++ )
+  {
+    total += loopNanos[i];
+  }
+
+  printf( "virtual time:         %u s, %u us per loop()\n", seconds, simLoopCostUs );
+  printf( "loop() passes:        %zu\n", loopNanos.size() );
+  printf( "host ns per loop():   mean %.1f  p99 %u  max %u\n", total / loopNanos.size(),
+          sorted[ sorted.size() * 99 / 100 ], sorted.back() );
+  printf( "signal packets sent:  %u%s\n", signalPackets, mast ? " ( mast mode )" : "" );
+  printf( "output writes/loop(): %.3f\n", (double)( simOutputWrites - writesAtStart ) / loopNanos.size() );
+#if OUTPUT_BACKEND == OUTPUT_MOCK
+  printf( "frames committed:     %u\n", simOutputCommits );
+#endif
+  printf( "EEPROM:               %u writes, %u us stalled\n", simEeprom.writes, simEeprom.stallMicros );
+  printf( "decoder counters:     loop max %u us, avg %u us, packets %u accepted %u rejected %u/s, frames %u late %u dropped, %u resets\n",
+          simReadCV16( CV_PERF_FIRST + 2 * PERF_LOOP_MAX ), simReadCV16( CV_PERF_FIRST + 2 * PERF_LOOP_AVG ),
+          simReadCV16( CV_PERF_FIRST + 2 * PERF_PACKETS_ACCEPTED ), simReadCV16( CV_PERF_FIRST + 2 * PERF_PACKETS_REJECTED ),
+          simReadCV16( CV_PERF_FIRST + 2 * PERF_PACKETS_PER_SEC ), simReadCV16( CV_PERF_FIRST + 2 * PERF_FRAMES_LATE ),
+          simReadCV16( CV_PERF_FIRST + 2 * PERF_FRAMES_DROPPED ), simReadCV16( CV_PERF_RESETS_LSB ) );
+  for( uint8_t headIndex = 0; headIndex < NUM_HEADS; headIndex++ )
+  {
+    FrameStats & s = stats[headIndex];
+    printf( "head %u:               %u keyframes, %u skipped, worst %.1f ms late; %u transitions, mean %.1f ms, longest %.1f ms\n",
+            headIndex, s.frames, s.skipped, s.worstLate / 1000.0, s.transitions,
+            s.transitions ? s.transitionTotal / s.transitions / 1000.0 : 0.0, s.worstTransition / 1000.0 );
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+/**********************************************************************
+
+EEPROM.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Host stand-in for the Arduino EEPROM library. Writes take
+  SIM_EEPROM_WRITE_US of virtual time, and a write started while the
+  previous one is still in progress stalls the caller like the AVR does.
+
+**********************************************************************/
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include "Arduino.h"
+
+#define SIM_EEPROM_SIZE      512                                      //  Same size as the ATtiny841 and ATmega328P EEPROM
+#define E2END                ( SIM_EEPROM_SIZE - 1 )                  //  Last EEPROM address, from <avr/io.h> on the target
+#define SIM_EEPROM_WRITE_US  3400                                     //  Erase + write time of one EEPROM byte
+
+void simSeedEeprom( uint8_t * cells );                                //  Supplied by the simulator to preload the CVs of a programmed decoder
+
+struct SimEeprom
+{
+  uint8_t   cell[ SIM_EEPROM_SIZE ];
+  uint32_t  readyAt;                                                  //  Virtual time at which the write in progress completes
+  uint32_t  writes;                                                   //  Number of bytes written since boot
+  uint32_t  stallMicros;                                              //  Virtual time spent waiting for a previous write
+
+  SimEeprom() : readyAt( 0 ), writes( 0 ), stallMicros( 0 )
+  {
+    memset( cell, 0xFF, sizeof( cell ) );                             //  Erased EEPROM reads as 0xFF
+    simSeedEeprom( cell );
+  }
+
+  bool isReady() { return (int32_t)( simMicros - readyAt ) >= 0; }
+
+  void write( uint16_t index, uint8_t value )
+  {
+    if( !isReady() )
+    {
+      stallMicros += readyAt - simMicros;
+      simMicros = readyAt;                                            //  Busy-wait for the previous write, as eeprom_write_byte() does
+    }
+    cell[ index % SIM_EEPROM_SIZE ] = value;
+    readyAt = simMicros + SIM_EEPROM_WRITE_US;
+    writes++;
+  }
+};
+
+SimEeprom simEeprom;
+
+class EEPROMClass
+{
+public:
+  uint8_t  read( int index )                  { return simEeprom.cell[ index % SIM_EEPROM_SIZE ]; }
+  void     write( int index, uint8_t value )  { simEeprom.write( index, value ); }
+  void     update( int index, uint8_t value ) { if( read( index ) != value ) write( index, value ); }
+  uint16_t length()                           { return SIM_EEPROM_SIZE; }
+};
+
+EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,110 @@
+/**********************************************************************
+
+HostSim.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Builds Searchlight.ino for the host and adds the helpers the simulator
+  and benchmark use to drive it: boot, queue DCC packets, write CVs and
+  step loop() on the virtual clock. Include this from exactly one .cpp.
+
+**********************************************************************/
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include "Arduino.h"
+#include "SimTrace.h"
+#include "../Searchlight/Searchlight.ino"
+
+uint32_t simLoopCostUs = 100;                                         //  Virtual time charged for each pass of loop()
+
+/////////////////////////////////
+//  DECODER STATE AT POWER UP  //
+/////////////////////////////////
+
+void simSeedEeprom( uint8_t * cells )                                 //  Boot as a decoder that already holds its factory default CVs
+{
+  for( uint8_t i = 0; i < sizeof( FactoryDefaultCVs ) / sizeof( CVPair ); i++ )
+  {
+    cells[ FactoryDefaultCVs[i].CV ] = FactoryDefaultCVs[i].Value;
+  }
+}
+
+void simBoot()
+{
+  memset( simPinLevel, HIGH, sizeof( simPinLevel ) );                 //  Programming jumper open, all inputs pulled up
+  setup();
+}
+
+/////////////////////
+//  DCC TRAFFIC    //
+/////////////////////
+
+DCC_MSG simSignalPacket( uint16_t outputAddr, uint8_t aspect )        //  Builds an extended accessory packet in output addressing mode
+{
+  DCC_MSG Msg;
+  uint16_t board = ( ( outputAddr - 1 ) >> 2 ) + 1;
+  uint8_t  pair = ( outputAddr - 1 ) & 0x03;
+
+  Msg.Size = 4;
+  Msg.PreambleBits = 14;
+  Msg.Data[0] = 0x80 | ( board & 0x3F );
+  Msg.Data[1] = ( ( ~( board >> 6 ) & 0x07 ) << 4 ) | ( pair << 1 ) | 0x01;
+  Msg.Data[2] = aspect & 0x1F;
+  Msg.Data[3] = Msg.Data[0] ^ Msg.Data[1] ^ Msg.Data[2];
+  return Msg;
+}
+
+DCC_MSG simIdlePacket()
+{
+  DCC_MSG Msg;
+  Msg.Size = 3;
+  Msg.PreambleBits = 14;
+  Msg.Data[0] = 0xFF;
+  Msg.Data[1] = 0x00;
+  Msg.Data[2] = 0xFF;
+  return Msg;
+}
+
+bool simSendAspect( uint8_t headIndex, uint8_t aspect )               //  Sends an aspect to one head at the decoder's current address
+{
+  return simQueuePacket( simSignalPacket( Dcc.getAddr() + headIndex, aspect ) );
+}
+
+bool simSendMastAspect( uint8_t mastAspect )                          //  Sends a mast aspect to the decoder's base address ( mast mode )
+{
+  return simQueuePacket( simSignalPacket( Dcc.getAddr(), mastAspect ) );
+}
+
+void simWriteCV( uint16_t CV, uint8_t Value )                         //  Same path an ops mode CV write takes through the library
+{
+  Dcc.setCV( CV, Value );
+}
+
+uint16_t simReadCV16( uint16_t CV )                                   //  Reads a 16 bit value held LSB first in CV and CV + 1
+{
+  return Dcc.getCV( CV ) | ( Dcc.getCV( CV + 1 ) << 8 );
+}
+
+////////////////////////
+//  RUNNING THE LOOP  //
+////////////////////////
+
+void simStep()
+{
+  loop();
+  simMicros += simLoopCostUs;
+}
+
+void simRunFor( uint32_t ms )
+{
+  uint32_t until = simMicros + ms * 1000;
+  while( (int32_t)( simMicros - until ) < 0 )
+  {
+    simStep();
+  }
+}
+
+#endif
@@ -0,0 +1,219 @@
+/**********************************************************************
+
+NmraDcc.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Host stand-in for the NmraDcc library (AddOutputModeAddressing branch).
+  Instead of sampling the DCC pin, process() takes one packet from a
+  queue filled by the simulator and dispatches it to the same notify
+  callbacks, with the same CV read/write hooks as the real library.
+
+**********************************************************************/
+
+#ifndef HOST_NMRADCC_H
+#define HOST_NMRADCC_H
+
+#include "Arduino.h"
+#include "EEPROM.h"
+
+#define MAX_DCC_MESSAGE_LEN                 6
+
+#define CV_ACCESSORY_DECODER_ADDRESS_LSB    1
+#define CV_ACCESSORY_DECODER_ADDRESS_MSB    9
+#define CV_VERSION_ID                       7
+#define CV_MANUFACTURER_ID                  8
+#define CV_29_CONFIG                        29
+
+#define MAN_ID_DIY                          0x0D
+
+#define FLAGS_MY_ADDRESS_ONLY               0x01
+#define FLAGS_AUTO_FACTORY_DEFAULT          0x02
+#define FLAGS_OUTPUT_ADDRESS_MODE           0x40
+#define FLAGS_DCC_ACCESSORY_DECODER         0x80
+
+typedef struct
+{
+  uint8_t   Size;
+  uint8_t   PreambleBits;
+  uint8_t   Data[ MAX_DCC_MESSAGE_LEN ];
+} DCC_MSG;
+
+/////////////////////////////////////////////////////////////////////
+//  CALLBACKS - WEAK, SO THE SKETCH ONLY DEFINES THE ONES IT USES  //
+/////////////////////////////////////////////////////////////////////
+
+extern "C" {
+extern void     notifyDccMsg( DCC_MSG * Msg )                             __attribute__ ((weak));
+extern void     notifyDccSigOutputState( uint16_t Addr, uint8_t State )   __attribute__ ((weak));
+extern void     notifyDccAccOutputAddrSet( uint16_t Addr )                __attribute__ ((weak));
+extern uint8_t  notifyCVValid( uint16_t CV, uint8_t Writable )            __attribute__ ((weak));
+extern uint8_t  notifyCVRead( uint16_t CV )                               __attribute__ ((weak));
+extern uint8_t  notifyCVWrite( uint16_t CV, uint8_t Value )               __attribute__ ((weak));
+extern uint8_t  notifyIsSetCVReady( void )                                __attribute__ ((weak));
+extern void     notifyCVChange( uint16_t CV, uint8_t Value )              __attribute__ ((weak));
+extern void     notifyCVResetFactoryDefault( void )                       __attribute__ ((weak));
+}
+
+//////////////////////////////////
+//  SIMULATED DCC PACKET QUEUE  //
+//////////////////////////////////
+
+#define SIM_PACKET_QUEUE_SIZE 64
+
+DCC_MSG   simPacketQueue[ SIM_PACKET_QUEUE_SIZE ];
+uint8_t   simPacketHead = 0;
+uint8_t   simPacketTail = 0;
+
+inline bool simQueuePacket( const DCC_MSG & Msg )                     //  Returns false if the queue is full
+{
+  uint8_t next = ( simPacketHead + 1 ) % SIM_PACKET_QUEUE_SIZE;
+  if( next == simPacketTail )
+  {
+    return false;
+  }
+  simPacketQueue[ simPacketHead ] = Msg;
+  simPacketHead = next;
+  return true;
+}
+
+inline uint8_t simPacketsPending()
+{
+  return ( simPacketHead + SIM_PACKET_QUEUE_SIZE - simPacketTail ) % SIM_PACKET_QUEUE_SIZE;
+}
+
+//////////////////////
+//  NMRADCC OBJECT  //
+//////////////////////
+
+class NmraDcc
+{
+public:
+  NmraDcc() : flags( 0 ), addrSetNextReceived( 0 ) {}
+
+  void pin( uint8_t ExtIntNum, uint8_t ExtIntPinNum, uint8_t EnablePullup ) {}
+
+  void init( uint8_t ManufacturerId, uint8_t VersionId, uint8_t Flags, uint8_t OpsModeAddressBaseCV )
+  {
+    flags = Flags;
+    if( readCV( CV_MANUFACTURER_ID ) != ManufacturerId )
+    {
+      writeCV( CV_MANUFACTURER_ID, ManufacturerId );
+    }
+    if( readCV( CV_VERSION_ID ) != VersionId )
+    {
+      writeCV( CV_VERSION_ID, VersionId );
+    }
+  }
+
+  uint8_t process()                                                   //  Handles at most one packet per call, like the real library
+  {
+    if( simPacketTail == simPacketHead )
+    {
+      return 0;
+    }
+    DCC_MSG Msg = simPacketQueue[ simPacketTail ];
+    simPacketTail = ( simPacketTail + 1 ) % SIM_PACKET_QUEUE_SIZE;
+
+    uint8_t check = 0;
+    for( uint8_t i = 0; i < Msg.Size; i++ )
+    {
+      check ^= Msg.Data[i];
+    }
+    if( check != 0 )
+    {
+      return 0;                                                       //  Bad error-detection byte, dropped as on the rail
+    }
+
+    if( notifyDccMsg )
+    {
+      notifyDccMsg( &Msg );
+    }
+
+    if( ( Msg.Data[0] & 0xC0 ) != 0x80 )                              //  Only accessory packets are decoded by the stand-in
+    {
+      return 1;
+    }
+
+    uint16_t BoardAddress = ( ( ( ~Msg.Data[1] ) & 0x70 ) << 2 ) | ( Msg.Data[0] & 0x3F );
+    uint8_t  TurnoutPairIndex = ( Msg.Data[1] & 0x06 ) >> 1;
+    uint16_t OutputAddress = ( ( ( BoardAddress - 1 ) << 2 ) | TurnoutPairIndex ) + 1;
+
+    if( addrSetNextReceived )
+    {
+      writeCV( CV_ACCESSORY_DECODER_ADDRESS_LSB, OutputAddress & 0xFF );
+      writeCV( CV_ACCESSORY_DECODER_ADDRESS_MSB, OutputAddress >> 8 );
+      addrSetNextReceived = 0;
+      if( notifyDccAccOutputAddrSet )
+      {
+        notifyDccAccOutputAddrSet( OutputAddress );
+      }
+      return 1;
+    }
+
+    if( ( Msg.Size == 4 ) && ( ( Msg.Data[1] & 0x89 ) == 0x01 ) )     //  Extended accessory (signal aspect) packet
+    {
+      if( notifyDccSigOutputState )
+      {
+        notifyDccSigOutputState( OutputAddress, Msg.Data[2] & 0x1F );
+      }
+    }
+    return 1;
+  }
+
+  uint8_t  getCV( uint16_t CV )                   { return readCV( CV ); }
+  uint8_t  setCV( uint16_t CV, uint8_t Value )    { return writeCV( CV, Value ); }
+
+  uint8_t isSetCVReady()
+  {
+    if( notifyIsSetCVReady )
+    {
+      return notifyIsSetCVReady();
+    }
+    return simEeprom.isReady();
+  }
+
+  uint16_t getAddr()
+  {
+    if( flags & FLAGS_OUTPUT_ADDRESS_MODE )
+    {
+      return ( readCV( CV_ACCESSORY_DECODER_ADDRESS_MSB ) << 8 ) | readCV( CV_ACCESSORY_DECODER_ADDRESS_LSB );
+    }
+    return ( ( readCV( CV_ACCESSORY_DECODER_ADDRESS_MSB ) & 0x07 ) << 6 ) | ( readCV( CV_ACCESSORY_DECODER_ADDRESS_LSB ) & 0x3F );
+  }
+
+  void setAccDecDCCAddrNextReceived( uint8_t enable )  { addrSetNextReceived = enable; }
+
+private:
+  uint8_t readCV( uint16_t CV )
+  {
+    if( notifyCVRead )
+    {
+      return notifyCVRead( CV );
+    }
+    return EEPROM.read( CV );
+  }
+
+  uint8_t writeCV( uint16_t CV, uint8_t Value )
+  {
+    if( notifyCVWrite )
+    {
+      return notifyCVWrite( CV, Value );
+    }
+    if( EEPROM.read( CV ) != Value )
+    {
+      EEPROM.write( CV, Value );
+      if( notifyCVChange )
+      {
+        notifyCVChange( CV, Value );
+      }
+    }
+    return EEPROM.read( CV );
+  }
+
+  uint8_t flags;
+  uint8_t addrSetNextReceived;
+};
+
+#endif
@@ -0,0 +1,43 @@
+/**********************************************************************
+
+OutputMock.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Host output backend ( OUTPUT_MOCK ). Keeps the level of every channel
+  for the simulator to inspect, traces each write and counts the frame
+  commits, so the commit stage can be checked without any PWM library.
+
+**********************************************************************/
+
+#ifndef HOST_OUTPUTMOCK_H
+#define HOST_OUTPUTMOCK_H
+
+#include "SimTrace.h"
+
+uint8_t  simOutputLevel[ NUM_OUTPUT_CHANNELS ];                       //  Pin level last written to each channel, common pole applied
+uint32_t simOutputCommits = 0;                                        //  Number of frames latched
+
+inline void outputBegin()
+{
+  memset( simOutputLevel, 0, sizeof( simOutputLevel ) );
+}
+
+inline void outputWrite( uint8_t channel, uint8_t level )
+{
+  simOutputWrites++;
+  level = pinLevel( level );                                          //  Trace what a pin backend would drive, as SoftPWM does
+  if( simOutputLevel[channel] != level )
+  {
+    simOutputLevel[channel] = level;
+    simTraceLevel( channel, level );
+  }
+}
+
+inline void outputLatch()
+{
+  simOutputCommits++;
+}
+
+#endif
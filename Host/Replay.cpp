@@ -0,0 +1,480 @@
+/**********************************************************************
+
+Replay.cpp
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Replays a trace of DCC packets through the sketch on the virtual clock,
+  as fast as the host can run it, and reports:
+
+    - host time spent in each pass of loop() and the number of packets
+      handled per host second, to compare the cost of code changes
+    - packets lost because the decoder fell behind the trace
+    - per aspect change, the time from the packet to the head's first
+      change of output level and to the head coming to rest
+    - the decoder's own packet counters, read back through CVs
+
+The trace is either a capture read from a decoder built with
+  DCC_CAPTURE ( see Searchlight/DccCapture.h ) or generated here. A
+  capture file holds the values of the capture CVs in the order read,
+  decimal or 0x hex, separated by white space.
+
+    usage: replay [-f capture] [-w file] [-d file] [-s seconds] [-c change ms]
+                  [-r repeat ms] [-p packet gap ms] [-o other ms] [-x speed]
+                  [-l loop cost us] [-m]
+
+      -f  replay this capture instead of generating a trace
+      -w  write the trace replayed to a capture file
+      -d  capture on the decoder while replaying, and write what it
+          captured, read back through CVs 59 - 61 and 96 - 111
+      -s  generated trace: virtual seconds ( default 60 )
+      -c  generated trace: mean time between aspect changes of each
+          head ( default 4000 ms )
+      -r  generated trace: command station refresh of every aspect
+          ( default 500 ms, 0 = off )
+      -p  generated trace: gap between idle packets ( default 6 ms )
+      -o  generated trace: gap between packets to other decoders'
+          signals ( default 20 ms, 0 = off )
+      -x  play the trace this many times faster than it was recorded,
+          to load the decoder harder ( default 1 )
+      -l  virtual time charged per pass of loop() ( default 100 us )
+      -m  mast mode, with the factory default mast table
+
+**********************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+
+#include "HostSim.h"
+
+#ifndef DCC_CAPTURE
+#error Replay needs the capture format, build it with -DDCC_CAPTURE
+#endif
+
+#define SETTLE_MS 5000                                                //  Run on after the last packet so the heads come to rest
+
+struct TraceEvent
+{
+  uint32_t us;                                                        //  Time from the start of the trace
+  DCC_MSG  Msg;
+};
+
+struct AspectChange
+{
+  bool     waiting;                                                   //  Aspect sent and the head has not come to rest yet
+  bool     lit;                                                       //  Output level of the head has changed since
+  bool     moved;                                                     //  Head has animated since
+  uint32_t sentAt;                                                    //  Virtual time the packet was queued, in microseconds
+};
+
+///////////////////////////
+//  TRACES AND CAPTURES  //
+///////////////////////////
+
+uint32_t seed = 1;
+
+uint32_t randomBelow( uint32_t limit )                                //  Fixed sequence, so a generated trace is the same every run
+{
+  seed = seed * 1103515245 + 12345;
+  return ( ( seed >> 16 ) & 0x7FFF ) % limit;
+}
+
+void addPacket( std::vector< TraceEvent > & events, uint32_t ms, const DCC_MSG & Msg )
+{
+  TraceEvent event = { ms * 1000, Msg };
+  events.push_back( event );
+}
+
+void generateTrace( std::vector< TraceEvent > & events, uint32_t seconds, uint32_t changeMs, uint32_t repeatMs,
+                    uint32_t packetGapMs, uint32_t otherMs, bool mast )
+{
+  uint16_t base = Dcc.getAddr();
+  uint8_t  firstHead = mast ? MAST_HEADS : 0;                         //  First head that still takes packets at its own address
+  uint8_t  signals = NUM_HEADS - firstHead + ( mast ? 1 : 0 );        //  Addresses sent to, the mast address first
+  uint32_t endMs = seconds * 1000;
+
+  for( uint8_t signal = 0; signal < signals; signal++ )
+  {
+    uint16_t addr = base + ( mast ? ( signal ? firstHead + signal - 1 : 0 ) : signal );
+    uint8_t  aspect = 0;
+    uint32_t nextRepeat = repeatMs;
+    for( uint32_t ms = changeMs / 2 + randomBelow( changeMs ); ms < endMs; ms += changeMs / 2 + randomBelow( changeMs ) )
+    {
+      while( repeatMs && ( nextRepeat < ms ) )
+      {
+        addPacket( events, nextRepeat, simSignalPacket( addr, aspect ) );
+        nextRepeat += repeatMs;
+      }
+      aspect = ( aspect + 1 + randomBelow( NUM_ASPECTS - 1 ) ) % NUM_ASPECTS;   //  Any aspect but the current one
+      addPacket( events, ms, simSignalPacket( addr, aspect ) );
+    }
+  }
+  for( uint32_t ms = 0; otherMs && ( ms < endMs ); ms += otherMs )
+  {
+    addPacket( events, ms, simSignalPacket( base + NUM_HEADS + randomBelow( 8 ), randomBelow( NUM_ASPECTS ) ) );
+  }
+  for( uint32_t ms = 0; packetGapMs && ( ms < endMs ); ms += packetGapMs )
+  {
+    addPacket( events, ms, simIdlePacket() );
+  }
+  std::stable_sort( events.begin(), events.end(), []( const TraceEvent & a, const TraceEvent & b ) { return a.us < b.us; } );
+}
+
+void decodeCapture( const std::vector< uint8_t > & bytes, std::vector< TraceEvent > & events )
+{
+  uint32_t ms = 0;
+  for( size_t i = 0; i + 2 <= bytes.size(); )
+  {
+    uint8_t gap = bytes[i];
+    uint8_t dataSize = bytes[ i + 1 ] & CAPTURE_LENGTH_MASK;
+    uint8_t idle = bytes[ i + 1 ] >> CAPTURE_IDLE_SHIFT;
+    if( ( dataSize == 0 ) || ( i + 2 + dataSize > bytes.size() ) )
+    {
+      break;                                                          //  Zero padding at the end of the last page
+    }
+    for( uint8_t k = 1; k <= idle; k++ )                              //  Only the count was kept, so spread them over the gap
+    {
+      TraceEvent event = { ms * 1000 + gap * 1000 * k / ( idle + 1 ), simIdlePacket() };
+      events.push_back( event );
+    }
+    ms += gap;
+
+    DCC_MSG Msg;
+    Msg.Size = dataSize + 1;
+    Msg.PreambleBits = 14;
+    Msg.Data[dataSize] = 0;
+    for( uint8_t k = 0; k < dataSize; k++ )
+    {
+      Msg.Data[k] = bytes[ i + 2 + k ];
+      Msg.Data[dataSize] ^= Msg.Data[k];
+    }
+    addPacket( events, ms, Msg );
+    i += 2 + dataSize;
+  }
+}
+
+void encodeCapture( const std::vector< TraceEvent > & events, std::vector< uint8_t > & bytes )   //  Same records as the decoder writes
+{
+  uint32_t lastMs = 0;
+  uint8_t  idle = 0;
+  for( size_t i = 0; i < events.size(); i++ )
+  {
+    const DCC_MSG & Msg = events[i].Msg;
+    if( ( Msg.Data[0] == 0xFF ) && ( idle < CAPTURE_IDLE_MAX ) )
+    {
+      idle++;
+      continue;
+    }
+    uint32_t ms = events[i].us / 1000;
+    bytes.push_back( std::min< uint32_t >( ms - lastMs, 255 ) );
+    bytes.push_back( ( idle << CAPTURE_IDLE_SHIFT ) | ( Msg.Size - 1 ) );
+    bytes.insert( bytes.end(), Msg.Data, Msg.Data + Msg.Size - 1 );
+    lastMs = ms;
+    idle = 0;
+  }
+}
+
+bool readCaptureFile( const char * name, std::vector< uint8_t > & bytes )
+{
+  FILE * file = fopen( name, "r" );
+  if( !file )
+  {
+    perror( name );
+    return false;
+  }
+  char token[16];
+  while( fscanf( file, "%15s", token ) == 1 )
+  {
+    bool hex = ( token[0] == '0' ) && ( ( token[1] == 'x' ) || ( token[1] == 'X' ) );
+    bytes.push_back( strtoul( token, NULL, hex ? 16 : 10 ) );
+  }
+  fclose( file );
+  return true;
+}
+
+bool writeCaptureFile( const char * name, const std::vector< uint8_t > & bytes )   //  One capture page per line
+{
+  FILE * file = fopen( name, "w" );
+  if( !file )
+  {
+    perror( name );
+    return false;
+  }
+  for( size_t i = 0; i < bytes.size(); i++ )
+  {
+    fprintf( file, "0x%02X%c", bytes[i], ( ( i % CAPTURE_PAGE_SIZE ) == CAPTURE_PAGE_SIZE - 1 ) || ( i + 1 == bytes.size() ) ? '\n' : ' ' );
+  }
+  fclose( file );
+  return true;
+}
+
+void readDecoderCapture( std::vector< uint8_t > & bytes )             //  Reads the ring back the way a command station would
+{
+  simWriteCV( CV_CAPTURE_MODE, 0 );
+  uint8_t length = Dcc.getCV( CV_CAPTURE_LENGTH );
+  for( uint8_t page = 0; page * CAPTURE_PAGE_SIZE < length; page++ )
+  {
+    simWriteCV( CV_CAPTURE_PAGE, page );
+    for( uint8_t i = 0; ( i < CAPTURE_PAGE_SIZE ) && ( page * CAPTURE_PAGE_SIZE + i < length ); i++ )
+    {
+      bytes.push_back( Dcc.getCV( CV_CAPTURE_WINDOW + i ) );
+    }
+  }
+}
+
+/////////////////////////////////
+//  ASPECT CHANGES IN THE TRACE  //
+/////////////////////////////////
+
+void packetTargets( const DCC_MSG & Msg, std::vector< std::pair< uint8_t, uint8_t > > & targets )   //  Heads and aspects a packet sets
+{
+  if( ( Msg.Size != 4 ) || ( ( Msg.Data[0] & 0xC0 ) != 0x80 ) || ( ( Msg.Data[1] & 0x89 ) != 0x01 ) )
+  {
+    return;
+  }
+  uint16_t board = ( ( ( ~Msg.Data[1] ) & 0x70 ) << 2 ) | ( Msg.Data[0] & 0x3F );
+  uint16_t addr = ( ( ( board - 1 ) << 2 ) | ( ( Msg.Data[1] & 0x06 ) >> 1 ) ) + 1;
+  uint8_t  aspect = Msg.Data[2] & 0x1F;
+
+  if( mastMode && ( addr == baseAddress ) )
+  {
+    for( uint8_t headIndex = 0; ( aspect < MAST_ASPECTS ) && ( headIndex < MAST_HEADS ); headIndex++ )
+    {
+      uint8_t entry = Dcc.getCV( CV_MAST_TABLE + aspect * MAST_TABLE_CVS + headIndex / 2 );
+      uint8_t headAspect = ( headIndex & 1 ) ? entry >> 4 : entry & 0x0F;
+      if( headAspect < NUM_ASPECTS )
+      {
+        targets.push_back( std::make_pair( headIndex, headAspect ) );
+      }
+    }
+  }
+  else if( ( addr >= baseAddress + ( mastMode ? MAST_HEADS : 0 ) ) && ( addr < baseAddress + NUM_HEADS ) && ( aspect < NUM_ASPECTS ) )
+  {
+    targets.push_back( std::make_pair( addr - baseAddress, aspect ) );
+  }
+}
+
+double percentile( std::vector< uint32_t > & values, uint32_t pct )
+{
+  if( values.empty() )
+  {
+    return 0;
+  }
+  std::sort( values.begin(), values.end() );
+  return values[ ( values.size() - 1 ) * pct / 100 ];
+}
+
+double mean( const std::vector< uint32_t > & values )
+{
+  double total = 0;
+  for( size_t i = 0; i < values.size(); i++ )
+  {
+    total += values[i];
+  }
+  return values.empty() ? 0 : total / values.size();
+}
+
+int main( int argc, char ** argv )
+{
+  const char * captureName = NULL;
+  const char * writeName = NULL;
+  const char * dumpName = NULL;
+  uint32_t seconds = 60;
+  uint32_t changeMs = 4000;
+  uint32_t repeatMs = 500;
+  uint32_t packetGapMs = 6;
+  uint32_t otherMs = 20;
+  double   speed = 1;
+  bool     mast = false;
+  int opt;
+
+  while( ( opt = getopt( argc, argv, "f:w:d:s:c:r:p:o:x:l:m" ) ) != -1 )
+  {
+    switch( opt )
+    {
+      case 'f': captureName = optarg; break;
+      case 'w': writeName = optarg; break;
+      case 'd': dumpName = optarg; break;
+      case 's': seconds = atoi( optarg ); break;
+      case 'c': changeMs = std::max( atoi( optarg ), 2 ); break;
+      case 'r': repeatMs = atoi( optarg ); break;
+      case 'p': packetGapMs = atoi( optarg ); break;
+      case 'o': otherMs = atoi( optarg ); break;
+      case 'x': speed = atof( optarg ); break;
+      case 'l': simLoopCostUs = atoi( optarg ); break;
+      case 'm': mast = true; break;
+      default:
+        fprintf( stderr, "usage: %s [-f capture] [-w file] [-d file] [-s seconds] [-c change ms] [-r repeat ms]\n"
+                         "       [-p packet gap ms] [-o other ms] [-x speed] [-l loop cost us] [-m]\n", argv[0] );
+        return 1;
+    }
+  }
+  if( speed <= 0 )
+  {
+    speed = 1;
+  }
+
+  simBoot();
+  if( mast )
+  {
+    simWriteCV( CV_MAST_MODE, 1 );
+  }
+  if( dumpName )
+  {
+    simWriteCV( CV_CAPTURE_MODE, 1 );
+  }
+
+  std::vector< TraceEvent > events;
+  if( captureName )
+  {
+    std::vector< uint8_t > bytes;
+    if( !readCaptureFile( captureName, bytes ) )
+    {
+      return 1;
+    }
+    decodeCapture( bytes, events );
+  }
+  else
+  {
+    generateTrace( events, seconds, changeMs, repeatMs, packetGapMs, otherMs, mast );
+  }
+  if( writeName )
+  {
+    std::vector< uint8_t > bytes;
+    encodeCapture( events, bytes );
+    if( !writeCaptureFile( writeName, bytes ) )
+    {
+      return 1;
+    }
+  }
+  for( size_t i = 0; i < events.size(); i++ )
+  {
+    events[i].us /= speed;
+  }
+
+  bool testing = true;
+  while( testing )                                                    //  Start the trace once the power-up lamp test is over
+  {
+    testing = false;
+    for( uint8_t headIndex = 0; headIndex < NUM_HEADS; headIndex++ )
+    {
+      testing |= heads.headStatus(headIndex) == STATE_LAMP_TEST;
+    }
+    simStep();
+  }
+
+  uint32_t accepted = simReadCV16( CV_PERF_FIRST + 2 * PERF_PACKETS_ACCEPTED );
+  uint32_t rejected = simReadCV16( CV_PERF_FIRST + 2 * PERF_PACKETS_REJECTED );
+  AspectChange change[ NUM_HEADS ] = {};
+  uint8_t  target[ NUM_HEADS ];
+  memset( target, ASPECT_NONE, sizeof( target ) );
+  std::vector< uint32_t > toFirstChange, toRest, loopNanos;
+  uint32_t changes = 0, superseded = 0, queued = 0, lost = 0;
+  double   hostNanos = 0;
+
+  uint32_t origin = simMicros;
+  uint32_t endUs = ( events.empty() ? 0 : events.back().us ) + SETTLE_MS * 1000;
+  std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+  size_t next = 0;
+
+  while( ( next < events.size() ) || ( simMicros - origin < endUs ) )
+  {
+    for( ; ( next < events.size() ) && ( origin + events[next].us <= simMicros ); next++ )
+    {
+      if( !simQueuePacket( events[next].Msg ) )
+      {
+        lost++;                                                       //  The decoder is more than a queue behind the trace
+        continue;
+      }
+      queued++;
+      std::vector< std::pair< uint8_t, uint8_t > > targets;
+      packetTargets( events[next].Msg, targets );
+      for( size_t t = 0; t < targets.size(); t++ )
+      {
+        uint8_t headIndex = targets[t].first;
+        if( targets[t].second == target[headIndex] )
+        {
+          continue;                                                   //  A repeat, not an aspect change
+        }
+        target[headIndex] = targets[t].second;
+        changes++;
+        superseded += change[headIndex].waiting;
+        change[headIndex].waiting = true;
+        change[headIndex].lit = false;
+        change[headIndex].moved = false;
+        change[headIndex].sentAt = simMicros;
+      }
+    }
+
+    uint8_t levelsBefore[ NUM_OUTPUT_CHANNELS ];
+    memcpy( levelsBefore, outputLevels, sizeof( levelsBefore ) );
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    loop();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    uint32_t nanos = std::chrono::duration_cast< std::chrono::nanoseconds >( t1 - t0 ).count();
+    loopNanos.push_back( nanos );
+    hostNanos += nanos;
+    uint32_t passStart = simMicros;
+    simMicros += simLoopCostUs;
+
+    for( uint8_t headIndex = 0; headIndex < NUM_HEADS; headIndex++ )
+    {
+      AspectChange & c = change[headIndex];
+      if( !c.waiting )
+      {
+        continue;
+      }
+      byte status = heads.headStatus(headIndex);
+      if( !c.lit && memcmp( &levelsBefore[ headIndex * 3 ], &outputLevels[ headIndex * 3 ], 3 ) )
+      {
+        c.lit = true;
+        toFirstChange.push_back( passStart - c.sentAt );
+      }
+      c.moved |= ( status == STATE_ANIMATE ) || ( status == STATE_ANIMATE_BLACK );
+      if( c.moved && ( status == STATE_IDLE ) )
+      {
+        c.waiting = false;
+        toRest.push_back( passStart - c.sentAt );
+      }
+    }
+  }
+  double wallSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - wallStart ).count();
+
+  uint32_t unfinished = 0;
+  for( uint8_t headIndex = 0; headIndex < NUM_HEADS; headIndex++ )
+  {
+    unfinished += change[headIndex].waiting;
+  }
+  accepted = simReadCV16( CV_PERF_FIRST + 2 * PERF_PACKETS_ACCEPTED ) - accepted;
+  rejected = simReadCV16( CV_PERF_FIRST + 2 * PERF_PACKETS_REJECTED ) - rejected;
+  double virtualSeconds = ( simMicros - origin ) / 1e6;
+
+  printf( "trace:                %zu packets over %.1f s%s, %s\n", events.size(), virtualSeconds,
+          mast ? " ( mast mode )" : "", captureName ? captureName : "generated" );
+  printf( "replay speed:         %.0fx real time\n", virtualSeconds / wallSeconds );
+  printf( "host ns per loop():   mean %.1f  p99 %.0f  max %.0f\n", mean( loopNanos ), percentile( loopNanos, 99 ),
+          percentile( loopNanos, 100 ) );
+  printf( "packets handled:      %u, %.0f per host second in loop(), %u lost to a full queue\n", queued,
+          queued / ( hostNanos / 1e9 ), lost );
+  printf( "decoder counters:     %u signal packets accepted, %u rejected\n", accepted, rejected );
+  printf( "aspect changes:       %u, %u overtaken by the next, %u still moving at the end\n", changes, superseded, unfinished );
+  printf( "to first LED change:  mean %.1f ms  p99 %.1f ms  max %.1f ms\n", mean( toFirstChange ) / 1000,
+          percentile( toFirstChange, 99 ) / 1000, percentile( toFirstChange, 100 ) / 1000 );
+  printf( "to rest:              mean %.1f ms  p99 %.1f ms  max %.1f ms\n", mean( toRest ) / 1000,
+          percentile( toRest, 99 ) / 1000, percentile( toRest, 100 ) / 1000 );
+
+  if( dumpName )
+  {
+    std::vector< uint8_t > bytes;
+    readDecoderCapture( bytes );
+    if( !writeCaptureFile( dumpName, bytes ) )
+    {
+      return 1;
+    }
+    printf( "decoder capture:      %zu bytes written to %s\n", bytes.size(), dumpName );
+  }
+  return 0;
+}
@@ -0,0 +1,33 @@
+/**********************************************************************
+
+SimTrace.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Output trace shared by the host output backends. Every write that
+  reaches a backend is counted, and every change of channel level is
+  written to the trace file when one is open, one line per change:
+
+    <ms>.<us> <channel> <level>
+
+**********************************************************************/
+
+#ifndef HOST_SIMTRACE_H
+#define HOST_SIMTRACE_H
+
+#include <stdio.h>
+#include "Arduino.h"
+
+FILE *   simTrace = NULL;                                             //  Output trace, one line per change of channel level
+uint32_t simOutputWrites = 0;                                         //  Number of channel writes that reached the backend, changed or not
+
+inline void simTraceLevel( uint8_t channel, uint8_t level )
+{
+  if( simTrace )
+  {
+    fprintf( simTrace, "%lu.%03lu %u %u\n", (unsigned long)( simMicros / 1000 ), (unsigned long)( simMicros % 1000 ), channel, level );
+  }
+}
+
+#endif
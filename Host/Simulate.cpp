@@ -0,0 +1,66 @@
+/**********************************************************************
+
+Simulate.cpp
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Runs a fixed script of aspect changes and CV writes through the sketch
+  on the virtual clock and writes every change of output channel level to
+  a trace ( "<ms>.<us> <channel> <level>" per line ). Record a trace
+  before a change and diff it against one recorded after to see exactly
+  what the LEDs would do differently.
+
+    usage: simulate [trace file]   ( default is standard output )
+
+**********************************************************************/
+
+#include "HostSim.h"
+
+int main( int argc, char ** argv )
+{
+  simTrace = stdout;
+  if( argc > 1 )
+  {
+    simTrace = fopen( argv[1], "w" );
+    if( !simTrace )
+    {
+      perror( argv[1] );
+      return 1;
+    }
+  }
+
+  simBoot();
+  simRunFor( 8000 );                                                  //  Let the power-up lamp test finish, 3 heads x 5 steps x 500 ms
+
+  simSendAspect( 0, 2 );                                              //  Head 0: red to green, adjacent lens
+  simSendAspect( 1, 3 );                                              //  Head 1: red to lunar, bypasses yellow
+  simSendAspect( 2, 5 );                                              //  Head 2: red to flashing yellow
+  simRunFor( 3000 );
+
+  simSendAspect( 0, 3 );                                              //  Head 0: green to lunar, bypasses red and yellow
+  simSendAspect( 1, 0 );                                              //  Head 1: lunar to red, stops at the de-energized lens
+  simRunFor( 4000 );
+
+  simWriteCV( 44, 20 );                                               //  Dim the red LED of the yellow aspect while head 2 flashes yellow
+  simRunFor( 2000 );
+
+  simSendAspect( 2, 8 );                                              //  Head 2: dark
+  simSendAspect( 0, 0 );                                              //  Head 0: lunar to red
+  simRunFor( 4000 );
+
+  simWriteCV( CV_MAST_MODE, 1 );                                      //  Mast mode: one packet to the base address sets every head
+  simSendMastAspect( 1 );                                             //  All heads to yellow, in the same frame
+  simRunFor( 3000 );
+
+  simWriteCV( CV_MAST_TABLE + 2 * 9, 0x31 );                          //  Program mast aspect 9 as yellow over lunar over red
+  simWriteCV( CV_MAST_TABLE + 2 * 9 + 1, 0xF0 );
+  simSendMastAspect( 9 );
+  simRunFor( 4000 );
+
+  if( simTrace != stdout )
+  {
+    fclose( simTrace );
+  }
+  return 0;
+}
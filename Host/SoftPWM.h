@@ -0,0 +1,51 @@
+/**********************************************************************
+
+SoftPWM.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Host stand-in for Palatis' SoftPWM library, used when the host build
+  selects OUTPUT_SOFTPWM. Channel levels are kept in RAM for the
+  simulator to inspect, and every set() goes to the shared trace.
+
+**********************************************************************/
+
+#ifndef HOST_SOFTPWM_H
+#define HOST_SOFTPWM_H
+
+#include "SimTrace.h"
+
+namespace Palatis {
+
+template < uint8_t NUM_CHANNELS, uint8_t NUM_LEVELS >
+class HostSoftPWM
+{
+public:
+  void begin( unsigned long hertz )  { frequency = hertz; }
+
+  void set( uint8_t channel, uint8_t value )
+  {
+    simOutputWrites++;
+    if( channel >= NUM_CHANNELS || level[channel] == value )
+    {
+      return;
+    }
+    level[channel] = value;
+    simTraceLevel( channel, value );
+  }
+
+  uint8_t size() const                  { return NUM_CHANNELS; }
+  uint8_t PWMlevels() const             { return NUM_LEVELS; }
+
+  uint8_t       level[ NUM_CHANNELS ];
+  unsigned long frequency;
+};
+
+}
+
+#define SOFTPWM_DEFINE_CHANNEL( CHANNEL, DDR, PORT, BIT )
+#define SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS( CHANNEL_CNT, PWM_LEVELS ) \
+  namespace Palatis { HostSoftPWM< CHANNEL_CNT, PWM_LEVELS > SoftPWM; }
+
+#endif
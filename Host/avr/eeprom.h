@@ -0,0 +1,19 @@
+/**********************************************************************
+
+avr/eeprom.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Host stand-in for the part of avr-libc's EEPROM header the sketch uses.
+
+**********************************************************************/
+
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include "../EEPROM.h"
+
+#define eeprom_is_ready()   ( simEeprom.isReady() )
+
+#endif
@@ -11,7 +11,9 @@ Part of CESM_SEARCHLIGHT_CONTROLLER
 //  INCLUDE REQUIRED LIBRARIES  //
 //////////////////////////////////
 
+#if OUTPUT_BACKEND == OUTPUT_SOFTPWM
 #include <SoftPWM.h>                                                  //  Include SoftPWM library from here: https://github.com/Palatis/arduino-softpwm/ 
+#endif
 
 ///////////////////////////////////////////
 //  DEFINE PINS BASED ON SELECTED BOARD  //
@@ -25,6 +27,12 @@ Part of CESM_SEARCHLIGHT_CONTROLLER
 #define PROG_JUMPER_PIN   PIN_B2                                      //  Pin number that detects if decoder is in programming mode. Short to 
                                                                       //  ground to start programming mode (on-board pull-ups are enabled)
 
+#define SKETCH_RAM_BUDGET 256                                         //  Bytes of the 512 bytes of SRAM for the sketch's own tables, checked in Searchlight.h
+
+#if OUTPUT_BACKEND == OUTPUT_SOFTPWM
+
+#define BOARD_HEADS       3                                           //  Number of signal heads driven, three PWM channels each
+                                                                      
 #ifndef SERIAL_DEBUG                                                         
 SOFTPWM_DEFINE_CHANNEL(0, DDRA, PORTA, PORTA0);                       //  Creates soft PWM channel 0 on Port A0 (Pin 1)
 SOFTPWM_DEFINE_CHANNEL(1, DDRA, PORTA, PORTA1);                       //  Creates soft PWM channel 1 on Port A1 (Pin 2)
@@ -35,7 +43,26 @@ SOFTPWM_DEFINE_CHANNEL(5, DDRA, PORTA, PORTA5);                       //  Create
 SOFTPWM_DEFINE_CHANNEL(6, DDRA, PORTA, PORTA6);                       //  Creates soft PWM channel 6 on Port A6 (Pin 7)
 SOFTPWM_DEFINE_CHANNEL(7, DDRA, PORTA, PORTA7);                       //  Creates soft PWM channel 7 on Port A7 (Pin 8)
 SOFTPWM_DEFINE_CHANNEL(8, DDRB, PORTB, PORTB0);                       //  Creates soft PWM channel 8 on Port B0 (Pin 9)
-SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(9, 32);                         //  Defines the 9 soft PWM channels with 64 step resolution
+SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(BOARD_HEADS * 3, 32);           //  Defines the soft PWM channels with 32 step resolution
+#endif
+
+#elif OUTPUT_BACKEND == OUTPUT_HARDWARE_PWM
+
+#error CANNOT COMPILE - NOT ENOUGH HARDWARE PWM PINS ON THIS CHIP, PLEASE USE OUTPUT_SOFTPWM OR OUTPUT_TLC5947
+
+#elif OUTPUT_BACKEND == OUTPUT_TLC5947
+
+#if TLC5947_CHIPS > 1
+#error CANNOT COMPILE - THIS CHIP HAS THE RAM FOR ONE TLC5947 ONLY, PLEASE SET TLC5947_CHIPS TO 1
+#endif
+
+#define TLC5947_DATA_PIN  PIN_A0                                      //  Serial data in ( SIN ) of the first driver
+#define TLC5947_CLOCK_PIN PIN_A1                                      //  Clock ( SCLK ) of every driver
+#define TLC5947_LATCH_PIN PIN_A2                                      //  Latch ( XLAT ) of every driver
+
+#define BOARD_HEADS       6                                           //  18 of the driver's 24 channels, the state of eight heads does not fit
+                                                                      //  SKETCH_RAM_BUDGET
+
 #endif
 
 #elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)       //  PIN DEFINITIONS FOR ATMEGA328P/168 BOARDS
@@ -47,6 +74,10 @@ SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(9, 32);                         //  Define
 #define PROG_JUMPER_PIN   13                                          //  Pin number that detects if decoder is in programming mode. Short to 
                                                                       //  ground to start programming mode (on-board pull-ups are enabled)
 
+#if OUTPUT_BACKEND == OUTPUT_SOFTPWM
+
+#define BOARD_HEADS       3                                           //  Number of signal heads driven, three PWM channels each
+                                                                      
 #ifndef SERIAL_DEBUG                                                         
 SOFTPWM_DEFINE_CHANNEL(0, DDRD, PORTD, PORTD3);                       //  Creates soft PWM channel 0 on Port D3 (Pin 3)
 SOFTPWM_DEFINE_CHANNEL(1, DDRD, PORTD, PORTD4);                       //  Creates soft PWM channel 1 on Port D4 (Pin 4)
@@ -57,7 +88,22 @@ SOFTPWM_DEFINE_CHANNEL(5, DDRB, PORTB, PORTB0);                       //  Create
 SOFTPWM_DEFINE_CHANNEL(6, DDRB, PORTB, PORTB1);                       //  Creates soft PWM channel 6 on Port B1 (Pin 9)
 SOFTPWM_DEFINE_CHANNEL(7, DDRB, PORTB, PORTB2);                       //  Creates soft PWM channel 7 on Port B2 (Pin 10)
 SOFTPWM_DEFINE_CHANNEL(8, DDRB, PORTB, PORTB3);                       //  Creates soft PWM channel 8 on Port B3 (Pin 11)
-SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(9, 32);                         //  Defines the 9 soft PWM channels with 64 step resolution
+SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(BOARD_HEADS * 3, 32);           //  Defines the soft PWM channels with 32 step resolution
+#endif
+
+#elif OUTPUT_BACKEND == OUTPUT_HARDWARE_PWM
+
+#define BOARD_HEADS       2                                           //  Number of signal heads driven, limited by the spare timer PWM pins
+#define HARDWARE_PWM_PINS 3, 5, 6, 9, 10, 11                          //  Red, green and blue pin of each head in turn
+
+#elif OUTPUT_BACKEND == OUTPUT_TLC5947
+
+#define TLC5947_DATA_PIN  3                                           //  Serial data in ( SIN ) of the first driver
+#define TLC5947_CLOCK_PIN 4                                           //  Clock ( SCLK ) of every driver
+#define TLC5947_LATCH_PIN 5                                           //  Latch ( XLAT ) of every driver
+
+#define BOARD_HEADS       ( TLC5947_CHIPS * 8 )                       //  Eight heads per driver, drivers counted in Config.h
+
 #endif
 
 #elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)      //  PIN DEFINITIONS FOR ATMEGA2560/1280 BOARDS
@@ -69,6 +115,10 @@ SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(9, 32);                         //  Define
 #define PROG_JUMPER_PIN   13                                          //  Pin number that detects if decoder is in programming mode. Short to 
                                                                       //  ground to start programming mode (on-board pull-ups are enabled)
 
+#if OUTPUT_BACKEND == OUTPUT_SOFTPWM
+
+#define BOARD_HEADS       8                                           //  Number of signal heads driven, three PWM channels each
+                                                                      
 #ifndef SERIAL_DEBUG                                                         
 SOFTPWM_DEFINE_CHANNEL(0, DDRE, PORTE, PORTE5);                       //  Creates soft PWM channel 0 on Port E5 (Pin 3)
 SOFTPWM_DEFINE_CHANNEL(1, DDRG, PORTG, PORTG5);                       //  Creates soft PWM channel 1 on Port G5 (Pin 4)
@@ -79,7 +129,37 @@ SOFTPWM_DEFINE_CHANNEL(5, DDRH, PORTH, PORTH5);                       //  Create
 SOFTPWM_DEFINE_CHANNEL(6, DDRH, PORTH, PORTH6);                       //  Creates soft PWM channel 6 on Port H6 (Pin 9)
 SOFTPWM_DEFINE_CHANNEL(7, DDRB, PORTB, PORTB4);                       //  Creates soft PWM channel 7 on Port B4 (Pin 10)
 SOFTPWM_DEFINE_CHANNEL(8, DDRB, PORTB, PORTB5);                       //  Creates soft PWM channel 8 on Port B5 (Pin 11)
-SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(9, 32);                         //  Defines the 9 soft PWM channels with 64 step resolution
+SOFTPWM_DEFINE_CHANNEL(9, DDRA, PORTA, PORTA0);                       //  Creates soft PWM channel 9 on Port A0 (Pin 22)
+SOFTPWM_DEFINE_CHANNEL(10, DDRA, PORTA, PORTA1);                      //  Creates soft PWM channel 10 on Port A1 (Pin 23)
+SOFTPWM_DEFINE_CHANNEL(11, DDRA, PORTA, PORTA2);                      //  Creates soft PWM channel 11 on Port A2 (Pin 24)
+SOFTPWM_DEFINE_CHANNEL(12, DDRA, PORTA, PORTA3);                      //  Creates soft PWM channel 12 on Port A3 (Pin 25)
+SOFTPWM_DEFINE_CHANNEL(13, DDRA, PORTA, PORTA4);                      //  Creates soft PWM channel 13 on Port A4 (Pin 26)
+SOFTPWM_DEFINE_CHANNEL(14, DDRA, PORTA, PORTA5);                      //  Creates soft PWM channel 14 on Port A5 (Pin 27)
+SOFTPWM_DEFINE_CHANNEL(15, DDRA, PORTA, PORTA6);                      //  Creates soft PWM channel 15 on Port A6 (Pin 28)
+SOFTPWM_DEFINE_CHANNEL(16, DDRA, PORTA, PORTA7);                      //  Creates soft PWM channel 16 on Port A7 (Pin 29)
+SOFTPWM_DEFINE_CHANNEL(17, DDRC, PORTC, PORTC7);                      //  Creates soft PWM channel 17 on Port C7 (Pin 30)
+SOFTPWM_DEFINE_CHANNEL(18, DDRC, PORTC, PORTC6);                      //  Creates soft PWM channel 18 on Port C6 (Pin 31)
+SOFTPWM_DEFINE_CHANNEL(19, DDRC, PORTC, PORTC5);                      //  Creates soft PWM channel 19 on Port C5 (Pin 32)
+SOFTPWM_DEFINE_CHANNEL(20, DDRC, PORTC, PORTC4);                      //  Creates soft PWM channel 20 on Port C4 (Pin 33)
+SOFTPWM_DEFINE_CHANNEL(21, DDRC, PORTC, PORTC3);                      //  Creates soft PWM channel 21 on Port C3 (Pin 34)
+SOFTPWM_DEFINE_CHANNEL(22, DDRC, PORTC, PORTC2);                      //  Creates soft PWM channel 22 on Port C2 (Pin 35)
+SOFTPWM_DEFINE_CHANNEL(23, DDRC, PORTC, PORTC1);                      //  Creates soft PWM channel 23 on Port C1 (Pin 36)
+SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(BOARD_HEADS * 3, 32);           //  Defines the soft PWM channels with 32 step resolution
+#endif
+
+#elif OUTPUT_BACKEND == OUTPUT_HARDWARE_PWM
+
+#define BOARD_HEADS       4                                           //  Number of signal heads driven, limited by the spare timer PWM pins
+#define HARDWARE_PWM_PINS 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 44, 45     //  Red, green and blue pin of each head in turn
+
+#elif OUTPUT_BACKEND == OUTPUT_TLC5947
+
+#define TLC5947_DATA_PIN  3                                           //  Serial data in ( SIN ) of the first driver
+#define TLC5947_CLOCK_PIN 4                                           //  Clock ( SCLK ) of every driver
+#define TLC5947_LATCH_PIN 5                                           //  Latch ( XLAT ) of every driver
+
+#define BOARD_HEADS       ( TLC5947_CHIPS * 8 )                       //  Eight heads per driver, drivers counted in Config.h
+
 #endif
 
 #elif defined(__AVR_ATmega32U4__)                                     //  PIN DEFINITIONS FOR ATMEGA32U4 BOARDS
@@ -91,6 +171,10 @@ SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(9, 32);                         //  Define
 #define PROG_JUMPER_PIN   13                                          //  Pin number that detects if decoder is in programming mode. Short to 
                                                                       //  ground to start programming mode (on-board pull-ups are enabled)
                                                                       
+#if OUTPUT_BACKEND == OUTPUT_SOFTPWM
+
+#define BOARD_HEADS       3                                           //  Number of signal heads driven, three PWM channels each
+                                                                      
 #ifndef SERIAL_DEBUG                                                         
 SOFTPWM_DEFINE_CHANNEL(0, DDRD, PORTD, PORTD4);                       //  Creates soft PWM channel 0 on Port E5 (Pin 3)
 SOFTPWM_DEFINE_CHANNEL(1, DDRC, PORTC, PORTC6);                       //  Creates soft PWM channel 1 on Port G5 (Pin 4)
@@ -101,7 +185,39 @@ SOFTPWM_DEFINE_CHANNEL(5, DDRB, PORTB, PORTB5);                       //  Create
 SOFTPWM_DEFINE_CHANNEL(6, DDRB, PORTB, PORTB6);                       //  Creates soft PWM channel 6 on Port H6 (Pin 9)
 SOFTPWM_DEFINE_CHANNEL(7, DDRB, PORTB, PORTB7);                       //  Creates soft PWM channel 7 on Port B4 (Pin 10)
 SOFTPWM_DEFINE_CHANNEL(8, DDRD, PORTD, PORTD6);                       //  Creates soft PWM channel 8 on Port B5 (Pin 11)
-SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(9, 32);                         //  Defines the 9 soft PWM channels with 64 step resolution
+SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(BOARD_HEADS * 3, 32);           //  Defines the soft PWM channels with 32 step resolution
+#endif
+
+#elif OUTPUT_BACKEND == OUTPUT_HARDWARE_PWM
+
+#error CANNOT COMPILE - NOT ENOUGH HARDWARE PWM PINS ON THIS CHIP, PLEASE USE OUTPUT_SOFTPWM OR OUTPUT_TLC5947
+
+#elif OUTPUT_BACKEND == OUTPUT_TLC5947
+
+#define TLC5947_DATA_PIN  4                                           //  Serial data in ( SIN ) of the first driver
+#define TLC5947_CLOCK_PIN 5                                           //  Clock ( SCLK ) of every driver
+#define TLC5947_LATCH_PIN 6                                           //  Latch ( XLAT ) of every driver
+
+#define BOARD_HEADS       ( TLC5947_CHIPS * 8 )                       //  Eight heads per driver, drivers counted in Config.h
+
+#endif
+
+#elif defined(HOST_BUILD)                                             //  PIN DEFINITIONS FOR THE HOST SIMULATOR ( SEE Host/ )
+
+#define DCC_READ_PIN      2                                           //  Not sampled on the host, packets are queued by the simulator
+
+#define PROG_JUMPER_PIN   13                                          //  Pin number that detects if decoder is in programming mode. Driven by
+                                                                      //  the simulator through simPinLevel[]
+
+#ifndef BOARD_HEADS
+#define BOARD_HEADS       3                                           //  Number of heads simulated, can be overridden from the compiler command line
+#define SKETCH_RAM_BUDGET 256                                         //  Same heads as the ATtiny841, so hold the host build to its RAM budget
+#endif
+
+#if OUTPUT_BACKEND == OUTPUT_SOFTPWM && !defined(SERIAL_DEBUG)
+SOFTPWM_DEFINE_OBJECT_WITH_PWM_LEVELS(BOARD_HEADS * 3, 32);           //  Defines the simulated PWM channels with the same resolution as hardware
+#elif OUTPUT_BACKEND != OUTPUT_SOFTPWM && OUTPUT_BACKEND != OUTPUT_MOCK
+#error CANNOT COMPILE - THE HOST SIMULATOR ONLY SUPPORTS OUTPUT_SOFTPWM AND OUTPUT_MOCK
 #endif
 
 #else                                                                 //  COMPILER ERROR FOR NON-SUPPORTED BOARDS
@@ -0,0 +1,93 @@
+/**********************************************************************
+
+CVStore.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+RAM copy of the low CVs, so reading a CV never touches EEPROM and
+  writing one never waits for it. setup() loads the copy in one pass,
+  a write only marks the CV dirty if its value actually changed, and
+  loop() writes one dirty CV back to EEPROM per pass, and only when the
+  EEPROM is idle, so DCC processing never stalls behind a write.
+
+CVs at or above CV_STORE_SIZE are read and written straight from
+  EEPROM, as the library would do on its own.
+
+**********************************************************************/
+
+#include <avr/eeprom.h>                                               //  For eeprom_is_ready()
+
+///////////////////////
+//  SET UP CV STORE  //
+///////////////////////
+
+#define CV_STORE_SIZE 96                                              //  CVs 0 - 95 are held in RAM, which covers every CV the decoder uses
+
+byte    cvStore[ CV_STORE_SIZE ];
+byte    cvDirty[ CV_STORE_SIZE / 8 ];                                 //  One bit per CV changed in RAM but not yet written to EEPROM
+boolean cvStoreDirty = false;                                         //  Whether any bit in cvDirty is set
+
+void loadCVs()                                                        //  Copies the stored CVs to RAM, once at power up
+{
+  for(uint8_t CV = 0; CV < CV_STORE_SIZE; CV++)
+  {
+    cvStore[CV] = EEPROM.read( CV );
+  }
+}
+
+uint8_t readStoredCV( uint16_t CV )
+{
+  if( CV < CV_STORE_SIZE )
+  {
+    return cvStore[CV];
+  }
+  return EEPROM.read( CV );
+}
+
+boolean writeStoredCV( uint16_t CV, uint8_t Value )                   //  Returns true if the value changed
+{
+  if( CV < CV_STORE_SIZE )
+  {
+    if( cvStore[CV] == Value )
+    {
+      return false;
+    }
+    cvStore[CV] = Value;
+    cvDirty[ CV >> 3 ] |= 1 << ( CV & 7 );
+    cvStoreDirty = true;
+    return true;
+  }
+  if( EEPROM.read( CV ) == Value )
+  {
+    return false;
+  }
+  EEPROM.write( CV, Value );                                          //  Rare, waits if a background write is still in progress
+  return true;
+}
+
+void flushCVs()                                                       //  Starts the EEPROM write of one dirty CV, if the EEPROM is idle
+{
+  if( !cvStoreDirty || !eeprom_is_ready() )
+  {
+    return;
+  }
+  for(uint8_t group = 0; group < sizeof( cvDirty ); group++)
+  {
+    byte dirty = cvDirty[group];
+    if( !dirty )
+    {
+      continue;
+    }
+    uint8_t CV = group * 8;
+    while( !( dirty & 1 ) )
+    {
+      dirty >>= 1;
+      CV++;
+    }
+    cvDirty[group] &= ~( 1 << ( CV & 7 ) );
+    EEPROM.write( CV, cvStore[CV] );                                  //  Returns at once, the EEPROM finishes the write on its own
+    return;
+  }
+  cvStoreDirty = false;                                               //  Nothing left to write
+}
@@ -15,6 +15,36 @@ Part of CESM_SEARCHLIGHT_CONTROLLER
 
 #define DEFAULT_ADDRESS 40
 
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Time between redraws of an animating head (ms). The vane curves step every 30 ms and are
+//  interpolated in between, so a lower value gives smoother fades for more output writes.
+//  30 draws each curve step once, with no interpolation.
+
+#define ANIMATE_FRAME_TIME 10
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  LED Output - Choose ONE ( see BoardDefine.h for the pins and head count of each ):
+//
+//  Drive the LEDs with software PWM on any pins
+//  Drive the LEDs with the chip's hardware PWM timers ( fewer heads, no PWM interrupt )
+//  Drive the LEDs through daisy-chained TLC5947 LED drivers ( eight heads per driver, but one driver
+//  and six heads on the ATtiny841, for lack of RAM )
+
+#define OUTPUT_SOFTPWM        0
+#define OUTPUT_HARDWARE_PWM   1
+#define OUTPUT_TLC5947        2
+#define OUTPUT_MOCK           3                                       //  Host simulator only
+
+#ifndef OUTPUT_BACKEND
+#define OUTPUT_BACKEND  OUTPUT_SOFTPWM
+//#define OUTPUT_BACKEND  OUTPUT_HARDWARE_PWM
+//#define OUTPUT_BACKEND  OUTPUT_TLC5947
+#endif
+
+#define TLC5947_CHIPS   1                                             //  Number of TLC5947 drivers in the chain
+
 //////////////////////////////////////////////////////////////////////////////////////
 //
 //  Debug - Choose ONE:
@@ -28,6 +58,18 @@ Part of CESM_SEARCHLIGHT_CONTROLLER
 
 #define DEBUG_BAUD_RATE 115200
 
+//////////////////////////////////////////////////////////////////////////////////////
+//
+//  Keep the last DCC packets received in a RAM ring, to be read back through CVs
+//  ( see DccCapture.h ). Takes DCC_CAPTURE_SIZE bytes of SRAM, at most 255. An
+//  ATtiny841 only has room for about 40 ( see the RAM budget in Searchlight.h ).
+
+//#define DCC_CAPTURE
+
+#ifndef DCC_CAPTURE_SIZE
+#define DCC_CAPTURE_SIZE 128
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////
 //
 //  Force Restore to Factory Defaults Every time the Decoder is Restarted
@@ -0,0 +1,139 @@
+/**********************************************************************
+
+DccCapture.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Capture of the DCC packets received, kept in a RAM ring in a compact
+  binary format and read back through CVs, so a problem seen on a real
+  layout can be taken home and replayed ( see Host/Replay.cpp ). Only
+  built when DCC_CAPTURE is defined in Config.h.
+
+Each packet is one record:
+
+    byte 0   ms since the previous record, 255 = 255 ms or more
+    byte 1   bits 0-2 number of packet bytes that follow,
+             bits 3-7 idle packets received since the previous record
+    byte 2-  the packet, without its error-detection byte
+
+Idle packets are only counted, unless 31 go by without another packet,
+  in which case the idle packet is recorded itself. When the ring is
+  full the oldest whole records are dropped, so the ring always starts
+  on a record.
+
+To read a capture, write 0 to CV 59 to stop it, read the number of bytes
+  captured from CV 60, then for each page of 16 bytes write the page
+  number to CV 61 and read CVs 96 - 111. Writing 1 to CV 59 clears the
+  ring and starts again, and a capture left running starts again at
+  power up.
+
+**********************************************************************/
+
+#ifdef DCC_CAPTURE
+
+#if DCC_CAPTURE_SIZE > 255
+#error CANNOT COMPILE - DCC_CAPTURE_SIZE MUST BE 255 OR LESS
+#endif
+
+///////////////////////////
+//  SET UP CAPTURE RING  //
+///////////////////////////
+
+#define CV_CAPTURE_MODE         59                                    //  1 = capture running, any other value = stopped so it can be read
+#define CV_CAPTURE_LENGTH       60                                    //  Bytes in the ring, read-only
+#define CV_CAPTURE_PAGE         61                                    //  Page of the ring shown in the capture window
+#define CV_CAPTURE_WINDOW       96                                    //  CVs 96 - 111 show the selected page, read-only
+#define CAPTURE_PAGE_SIZE       16
+
+#define CAPTURE_LENGTH_MASK     0x07                                  //  Record header, see above
+#define CAPTURE_IDLE_SHIFT      3
+#define CAPTURE_IDLE_MAX        31
+
+byte     captureRing[ DCC_CAPTURE_SIZE ];
+uint8_t  captureStart = 0;                                            //  Oldest record
+uint8_t  captureLength = 0;                                           //  Bytes in use from captureStart on
+uint8_t  captureIdle = 0;                                             //  Idle packets since the last record
+uint8_t  capturePage = 0;
+uint16_t captureLastTime;                                             //  millis() of the last record
+boolean  captureOn = false;
+
+inline uint8_t captureIndex( uint8_t offset )                         //  Ring position of a byte offset from the oldest record
+{
+  uint16_t index = captureStart + offset;
+  return index >= DCC_CAPTURE_SIZE ? index - DCC_CAPTURE_SIZE : index;
+}
+
+inline void captureByte( byte value )
+{
+  captureRing[ captureIndex( captureLength ) ] = value;
+  captureLength++;
+}
+
+void setCaptureMode( uint8_t mode )                                   //  Follows CV_CAPTURE_MODE, only 1 runs the capture
+{
+  boolean on = ( mode == 1 );                                         //  0xFF on a decoder that never set CV 59 leaves it stopped
+  if( on && !captureOn )
+  {
+    captureStart = 0;
+    captureLength = 0;
+    captureIdle = 0;
+    captureLastTime = millis();
+  }
+  captureOn = on;
+}
+
+void capturePacket( DCC_MSG * Msg )                                   //  Adds a packet to the ring, called for every packet received
+{
+  if( !captureOn )
+  {
+    return;
+  }
+  if( ( Msg->Data[0] == 0xFF ) && ( captureIdle < CAPTURE_IDLE_MAX ) )
+  {
+    captureIdle++;                                                    //  Idle packets are most of the traffic, so only count them
+    return;
+  }
+
+  uint8_t dataSize = Msg->Size - 1;
+  uint8_t recordSize = 2 + dataSize;
+  while( captureLength + recordSize > DCC_CAPTURE_SIZE )              //  Make room by dropping the oldest records
+  {
+    uint8_t oldest = 2 + ( captureRing[ captureIndex( 1 ) ] & CAPTURE_LENGTH_MASK );
+    captureStart = captureIndex( oldest );
+    captureLength -= oldest;
+  }
+
+  uint16_t now = millis();
+  uint16_t gap = now - captureLastTime;
+  captureLastTime = now;
+  captureByte( gap > 255 ? 255 : gap );
+  captureByte( ( captureIdle << CAPTURE_IDLE_SHIFT ) | dataSize );
+  for(uint8_t i = 0; i < dataSize; i++)
+  {
+    captureByte( Msg->Data[i] );
+  }
+  captureIdle = 0;
+}
+
+boolean isCaptureCV( uint16_t CV )                                    //  CVs served from the capture ring rather than the CV store
+{
+  return ( CV == CV_CAPTURE_LENGTH ) || ( CV == CV_CAPTURE_PAGE ) ||
+         ( ( CV >= CV_CAPTURE_WINDOW ) && ( CV < CV_CAPTURE_WINDOW + CAPTURE_PAGE_SIZE ) );
+}
+
+uint8_t readCaptureCV( uint16_t CV )
+{
+  if( CV == CV_CAPTURE_LENGTH )
+  {
+    return captureLength;
+  }
+  if( CV == CV_CAPTURE_PAGE )
+  {
+    return capturePage;
+  }
+  uint16_t offset = capturePage * CAPTURE_PAGE_SIZE + ( CV - CV_CAPTURE_WINDOW );
+  return offset < captureLength ? captureRing[ captureIndex( offset ) ] : 0;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/**********************************************************************
+
+Output.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Frame-commit stage between the vane animation and the LED outputs.
+  Heads write their channel levels into a shadow array, and loop()
+  commits the frame once per pass, pushing only the channels that
+  changed to the output backend selected in Config.h.
+
+Every backend provides three functions:
+
+    outputBegin()                  set up the pins / timers / driver
+    outputWrite( channel, level )  one changed channel, level 0 - 32
+    outputLatch()                  end of a frame, after all the writes
+
+Levels are how bright each LED should be. Backends that drive the LEDs
+  straight from chip pins turn them into pin levels with pinLevel(),
+  which inverts them for common anode heads ( CV 55 = 1 ).
+
+**********************************************************************/
+
+//////////////////////////////
+//  SET UP OUTPUT CHANNELS  //
+//////////////////////////////
+
+#define NUM_OUTPUT_CHANNELS ( NUM_HEADS * 3 )                         //  Red, green and blue channel for each head
+#define MAX_OUTPUT_LEVEL    32                                        //  Full on, levels above this are clamped by the backends
+
+uint8_t outputLevels[ NUM_OUTPUT_CHANNELS ];                          //  Brightness of each LED, before any common pole inversion
+uint8_t outputDirty[ ( NUM_OUTPUT_CHANNELS + 7 ) / 8 ];               //  One bit per channel changed since the last commit
+boolean outputChanged = false;                                        //  Whether any bit in outputDirty is set
+
+inline void setOutputLevel( uint8_t channel, uint8_t level )          //  Stages a channel level for the next commit
+{
+  if( outputLevels[channel] != level )
+  {
+    outputLevels[channel] = level;
+    outputDirty[ channel >> 3 ] |= 1 << ( channel & 7 );
+    outputChanged = true;
+  }
+}
+
+void redrawOutputs()                                                  //  Marks every channel changed, so the next commit writes them all
+{
+  for(uint8_t channel = 0; channel < NUM_OUTPUT_CHANNELS; channel++)
+  {
+    outputDirty[ channel >> 3 ] |= 1 << ( channel & 7 );
+  }
+  outputChanged = true;
+}
+
+inline uint8_t pinLevel( uint8_t level )                              //  Common anode LEDs light while their pin is low, so invert for them
+{
+  if( !commonPole )
+  {
+    return level;
+  }
+  return level >= MAX_OUTPUT_LEVEL ? 0 : MAX_OUTPUT_LEVEL - level;
+}
+
+/////////////////////////////
+//  SELECT OUTPUT BACKEND  //
+/////////////////////////////
+
+#if defined(SERIAL_DEBUG)                                             //  LED pins are shared with the serial line, so drive nothing
+
+inline void outputBegin() {}
+inline void outputWrite( uint8_t channel, uint8_t level ) {}
+inline void outputLatch() {}
+
+#elif OUTPUT_BACKEND == OUTPUT_SOFTPWM
+#include "OutputSoftPWM.h"
+#elif OUTPUT_BACKEND == OUTPUT_HARDWARE_PWM
+#include "OutputHardwarePWM.h"
+#elif OUTPUT_BACKEND == OUTPUT_TLC5947
+#include "OutputTLC5947.h"
+#elif OUTPUT_BACKEND == OUTPUT_MOCK
+#include <OutputMock.h>                                               //  Host only, see Host/
+#else
+#error CANNOT COMPILE - PLEASE SELECT AN OUTPUT BACKEND IN Config.h
+#endif
+
+void commitOutputs()                                                  //  Pushes every channel changed since the last commit to the backend
+{
+  if( !outputChanged )
+  {
+    return;
+  }
+  outputChanged = false;
+  for(uint8_t group = 0; group < sizeof( outputDirty ); group++)
+  {
+    byte dirty = outputDirty[group];
+    if( !dirty )
+    {
+      continue;                                                       //  Skip eight unchanged channels at a time
+    }
+    outputDirty[group] = 0;
+    for(uint8_t channel = group * 8; dirty; channel++, dirty >>= 1)
+    {
+      if( dirty & 1 )
+      {
+        outputWrite( channel, outputLevels[channel] );
+      }
+    }
+  }
+  outputLatch();
+}
@@ -0,0 +1,30 @@
+/**********************************************************************
+
+OutputHardwarePWM.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Output backend for the chip's own timer PWM pins through analogWrite().
+  No interrupt load, but only as many heads as the board has spare
+  PWM pins ( HARDWARE_PWM_PINS in BoardDefine.h ).
+
+**********************************************************************/
+
+const uint8_t hardwarePwmPins[ NUM_OUTPUT_CHANNELS ] = { HARDWARE_PWM_PINS };   //  Red, green and blue pin of each head in turn
+
+inline void outputBegin()
+{
+  for(uint8_t channel = 0; channel < NUM_OUTPUT_CHANNELS; channel++)
+  {
+    pinMode( hardwarePwmPins[channel], OUTPUT );
+  }
+}
+
+inline void outputWrite( uint8_t channel, uint8_t level )
+{
+  level = pinLevel( level );
+  analogWrite( hardwarePwmPins[channel], level >= MAX_OUTPUT_LEVEL ? 255 : level << 3 );   //  Scale 0 - 32 to the 8 bit timer
+}
+
+inline void outputLatch() {}                                          //  Each compare register takes effect on its own
@@ -0,0 +1,24 @@
+/**********************************************************************
+
+OutputSoftPWM.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Output backend for Palatis' SoftPWM library. Works on any pins ( the
+  channels are defined in BoardDefine.h ), at the cost of a timer
+  interrupt that runs 32 levels x 120 Hz for every channel.
+
+**********************************************************************/
+
+inline void outputBegin()
+{
+  Palatis::SoftPWM.begin(120);                                        //  Begin soft PWM with 120hz pwm frequency
+}
+
+inline void outputWrite( uint8_t channel, uint8_t level )
+{
+  Palatis::SoftPWM.set( channel, pinLevel( level ) );
+}
+
+inline void outputLatch() {}                                          //  SoftPWM picks up new levels on its next cycle
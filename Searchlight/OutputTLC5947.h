@@ -0,0 +1,71 @@
+/**********************************************************************
+
+OutputTLC5947.h
+COPYRIGHT (C) 2017 David J. Cutting
+
+Part of CESM_SEARCHLIGHT_CONTROLLER
+
+Output backend for daisy-chained TLC5947 24 channel, 12 bit LED drivers
+  ( eight heads per driver ). The drivers make their own PWM, so there is
+  no interrupt load. The chain is one long shift register, so a commit
+  with any change clocks out every channel and then pulses the latch.
+  Tie the BLANK pin of each driver low.
+
+That is 288 bits per driver for every commit, so the data and clock pins
+  are driven straight through their port registers. Each bit takes a few
+  cycles rather than three digitalWrite() calls, which on an 8 MHz
+  ATtiny841 cuts a one driver commit from over 3 ms to well under 0.5 ms.
+  The registers are looked up once in outputBegin(). Nothing else may
+  write the data or clock port from an interrupt.
+
+The drivers sink the current of common anode LEDs and their grayscale
+  is the LED on time, so levels go out as they are, without the common
+  pole inversion of the pin backends. CV 55 has no effect here.
+
+**********************************************************************/
+
+#define TLC5947_CHANNELS ( TLC5947_CHIPS * 24 )                       //  Channels in the whole chain, the last ones may be unused
+
+volatile uint8_t * tlcDataPort;                                       //  Output registers and bit masks of the data and clock pins
+volatile uint8_t * tlcClockPort;
+uint8_t            tlcDataBit;
+uint8_t            tlcClockBit;
+
+inline void outputBegin()
+{
+  pinMode( TLC5947_DATA_PIN, OUTPUT );
+  pinMode( TLC5947_CLOCK_PIN, OUTPUT );
+  pinMode( TLC5947_LATCH_PIN, OUTPUT );
+  digitalWrite( TLC5947_CLOCK_PIN, LOW );
+  digitalWrite( TLC5947_LATCH_PIN, LOW );
+  tlcDataPort  = portOutputRegister( digitalPinToPort( TLC5947_DATA_PIN ) );
+  tlcClockPort = portOutputRegister( digitalPinToPort( TLC5947_CLOCK_PIN ) );
+  tlcDataBit   = digitalPinToBitMask( TLC5947_DATA_PIN );
+  tlcClockBit  = digitalPinToBitMask( TLC5947_CLOCK_PIN );
+}
+
+inline void outputWrite( uint8_t channel, uint8_t level ) {}          //  Levels are read from outputLevels[] when the chain is latched
+
+void outputLatch()
+{
+  for(int channel = TLC5947_CHANNELS - 1; channel >= 0; channel--)    //  Last channel of the last driver goes out first
+  {
+    uint8_t  level = channel < NUM_OUTPUT_CHANNELS ? outputLevels[channel] : 0;
+    uint16_t value = level >= MAX_OUTPUT_LEVEL ? 4095 : level << 7;  //  Scale 0 - 32 to the 12 bit driver
+    for(uint16_t bit = 0x800; bit; bit >>= 1)                         //  Most significant bit first
+    {
+      if( value & bit )
+      {
+        *tlcDataPort |= tlcDataBit;
+      }
+      else
+      {
+        *tlcDataPort &= ~tlcDataBit;
+      }
+      *tlcClockPort |= tlcClockBit;                                   //  Driver samples the data on the rising edge
+      *tlcClockPort &= ~tlcClockBit;
+    }
+  }
+  digitalWrite( TLC5947_LATCH_PIN, HIGH );                            //  Move the shifted levels to the outputs
+  digitalWrite( TLC5947_LATCH_PIN, LOW );
+}
@@ -18,7 +18,19 @@ Part of CESM_SEARCHLIGHT_CONTROLLER
 //////////////////////////////////
 
 #include <NmraDcc.h>                                                  //  You must use the branch available here: https://github.com/mrrwa/NmraDcc/tree/AddOutputModeAddressing
-#include <SoftPWM.h>                                                  //  Include SoftPWM library from here: https://github.com/Palatis/arduino-softpwm/ 
+#include <EEPROM.h>
+
+////////////////////////
+//  INCLUDE CV STORE  //
+////////////////////////
+
+#include "CVStore.h"                                                  //  RAM copy of the CVs, written back to EEPROM in the background
+
+///////////////////////////
+//  INCLUDE DCC CAPTURE  //
+///////////////////////////
+
+#include "DccCapture.h"                                               //  Ring of the DCC packets received, when DCC_CAPTURE is defined
 
 //////////////////////////
 //  CREATE DCC OBJECTS  //
@@ -43,6 +55,7 @@ ADDR_SET_MODE AddrSetMode = ADDR_SET_DISABLED ;                       //  Keeps
 uint16_t baseAddress;                                                 //  Keeps track of the base address of the decoder
 uint8_t FactoryDefaultCVIndex = 0;                                    //  Controls reset of the decoder
 uint8_t commonPole;                                                   //  Keeps track of whether the decoder is set up as common anode or common cathode
+boolean mastMode;                                                     //  CV_MAST_MODE, whether the base address takes mast aspects
 
 /////////////////////////////////////
 //  SET UP EFFECT TIMER VARIABLES  //
@@ -50,12 +63,44 @@ uint8_t commonPole;                                                   //  Keeps
 
 #define ANIMATE_DELAY_TIME 30
 #define FLASH_PULSE_DELAY 1000
+#define INPUT_STABILIZE_TIME 10                                       //  Time an aspect must stay unchanged before its animation starts (ms)
+
+///////////////////////////////////
+//  SET UP PERFORMANCE COUNTERS  //
+///////////////////////////////////
+
+//  Runtime counters, read as CVs so a decoder on the layout can be checked from the command station. Each counter
+//  is 16 bits, LSB in the even CV and MSB in the odd CV, and stops at 65535 instead of wrapping. All but the reset
+//  count live in RAM and start over at power up. Writes to CVs 112-127 are refused.
+
+#define CV_PERF_FIRST         112
+#define CV_PERF_LAST          127
+
+#define PERF_LOOP_MAX         0                                       //  CV 112/113 - Worst-case time between passes of loop() (us)
+#define PERF_LOOP_AVG         1                                       //  CV 114/115 - Average time between passes of loop() (us)
+#define PERF_PACKETS_ACCEPTED 2                                       //  CV 116/117 - Signal packets addressed to one of our heads
+#define PERF_PACKETS_REJECTED 3                                       //  CV 118/119 - Signal packets for other addresses or with a bad aspect
+#define PERF_PACKETS_PER_SEC  4                                       //  CV 120/121 - DCC packets of any kind received in the last full second
+#define PERF_FRAMES_LATE      5                                       //  CV 122/123 - Head deadlines serviced FRAME_LATE_TIME or more late
+#define PERF_FRAMES_DROPPED   6                                       //  CV 124/125 - Head deadlines serviced a whole animation frame late
+#define PERF_COUNTERS         7
+
+#define CV_PERF_RESETS_LSB    126                                     //  Number of times the decoder has started, kept in EEPROM
+#define CV_PERF_RESETS_MSB    127
+
+#define FRAME_LATE_TIME       2                                       //  Lateness (ms) that counts as a late frame, one tick of millis() is normal
+
+uint16_t perfCounters[ PERF_COUNTERS ];
+uint32_t loopTimeAvg16 = 0;                                           //  Running average of the loop time, times 16
+uint32_t lastLoopStart = 0;                                           //  micros() at the start of the previous pass of loop()
+uint16_t packetsThisSecond = 0;
+uint16_t packetSecondStart = 0;                                       //  Low 16 bits of millis() when packetsThisSecond started
 
 ////////////////////////////////////
 //  SET UP SIGNAL HEAD CONSTANTS  //
 ////////////////////////////////////
 
-#define NUM_HEADS   3                                                 //  Defines 3 heads on signal decoder if the searchlight configuration is selected
+constexpr uint8_t NUM_HEADS = BOARD_HEADS;                            //  Number of searchlight heads, set for each board in BoardDefine.h
 #define NUM_ASPECTS 9                                                 //  Defines 9 possible aspects (controlled by aspectTable)
 #define NUM_COLORS  5                                                 //  Defines 5 possible colors for output
 
@@ -68,6 +113,7 @@ uint8_t commonPole;                                                   //  Keeps
 #define STATE_IDLE          0                                         //  Idle state ID for switch case
 #define STATE_ANIMATE       1                                         //  Dimming ID for switch case
 #define STATE_ANIMATE_BLACK 2                                         //  ID for case where animation is being switched and signal is black momentarily
+#define STATE_LAMP_TEST     3                                         //  ID for a head still in its power-up lamp test
 
 #define OFF 0                                                         //  Defines off as 0
 #define ON  1                                                         //  Defines on as 1
@@ -80,13 +126,29 @@ uint8_t commonPole;                                                   //  Keeps
                                                                       //  that controls it.
                                                                       
 
+#define CV_LAMP_TEST_STEP       56                                    //  Time each lamp test color is shown, in 10 ms units. 0 skips the lamp test
+#define CV_LAMP_TEST_MODE       57                                    //  Lamp test options:
+#define LAMP_TEST_CONCURRENT    0x01                                  //    Test all heads at once instead of one after another
+#define LAMP_TEST_SHORT         0x02                                  //    Show only red, green and blue, skipping the off and white steps
+#define LAMP_TEST_DEFAULT_STEP  50                                    //  Step time used when CV 56 reads 0xFF, on a decoder that never set it
+
+#define CV_MAST_MODE            58                                    //  1 = mast mode: the base address takes mast aspects, set out in the mast table.
+                                                                      //  Any other value, such as 0xFF on a decoder that never set it, is off
+#define CV_MAST_TABLE           64                                    //  Mast table, MAST_ASPECTS entries of MAST_TABLE_CVS CVs each ( CVs 64 - 95 )
+#define MAST_ASPECTS            16                                    //  Mast aspects 0 - 15 can be sent to the base address
+#define MAST_TABLE_HEADS        4                                     //  Heads set by each mast table entry, one aspect per nibble
+#define MAST_TABLE_CVS          ( MAST_TABLE_HEADS / 2 )              //  CVs per mast table entry: heads 0 ( low nibble ) and 1, then heads 2 and 3
+#define MAST_HEADS              ( NUM_HEADS < MAST_TABLE_HEADS ? NUM_HEADS : MAST_TABLE_HEADS )
+                                                                      //  Heads after these keep their own addresses in mast mode
+#define MAST_KEEP               0x0F                                  //  Mast table nibble that leaves the head on its current aspect
+
 struct CVPair
 {
   uint16_t  CV;
   uint8_t   Value;
 };
 
-CVPair FactoryDefaultCVs[] =
+const CVPair FactoryDefaultCVs[] PROGMEM =
 {
   {CV_ACCESSORY_DECODER_ADDRESS_LSB, DEFAULT_ADDRESS + 1},            //  Set the accessory decoder address. Needs to be +1 to be compatible with DCC Spec
   {CV_ACCESSORY_DECODER_ADDRESS_MSB, 0},                             
@@ -118,14 +180,87 @@ CVPair FactoryDefaultCVs[] =
   {54, 1},                                                            //  Enable/Disable flashing 
 
   {55, 1},                                                            //  Polarity for all heads - 1 = Common Anode, 0 = Common Cathode 
+
+  {CV_LAMP_TEST_STEP, LAMP_TEST_DEFAULT_STEP},                        //  Lamp test time per color, in 10 ms units (0 = no lamp test)
+  {CV_LAMP_TEST_MODE, 0},                                             //  Lamp test options, see LAMP_TEST_CONCURRENT and LAMP_TEST_SHORT
+
+#ifdef DCC_CAPTURE
+  {CV_CAPTURE_MODE, 0},                                               //  DCC packet capture stopped
+#endif
+
+  {CV_MAST_MODE, 0},                                                  //  Each head on its own address ( 1 = mast mode )
+  {CV_MAST_TABLE + 0, 0x00},                                          //  Mast aspect 0: every head shows aspect 0 (red)
+  {CV_MAST_TABLE + 1, 0x00},
+  {CV_MAST_TABLE + 2, 0x11},                                          //  Mast aspect 1: every head shows aspect 1 (yellow)
+  {CV_MAST_TABLE + 3, 0x11},
+  {CV_MAST_TABLE + 4, 0x22},                                          //  Mast aspect 2: every head shows aspect 2 (green)
+  {CV_MAST_TABLE + 5, 0x22},
+  {CV_MAST_TABLE + 6, 0x33},                                          //  Mast aspect 3: every head shows aspect 3 (lunar)
+  {CV_MAST_TABLE + 7, 0x33},
+  {CV_MAST_TABLE + 8, 0x44},                                          //  Mast aspect 4: every head shows aspect 4 (flashing red)
+  {CV_MAST_TABLE + 9, 0x44},
+  {CV_MAST_TABLE + 10, 0x55},                                         //  Mast aspect 5: every head shows aspect 5 (flashing yellow)
+  {CV_MAST_TABLE + 11, 0x55},
+  {CV_MAST_TABLE + 12, 0x66},                                         //  Mast aspect 6: every head shows aspect 6 (flashing green)
+  {CV_MAST_TABLE + 13, 0x66},
+  {CV_MAST_TABLE + 14, 0x77},                                         //  Mast aspect 7: every head shows aspect 7 (flashing lunar)
+  {CV_MAST_TABLE + 15, 0x77},
+  {CV_MAST_TABLE + 16, 0x88},                                         //  Mast aspect 8: every head shows aspect 8 (dark)
+  {CV_MAST_TABLE + 17, 0x88},
+  {CV_MAST_TABLE + 18, 0xFF},                                         //  Mast aspect 9: unused, every head keeps its aspect
+  {CV_MAST_TABLE + 19, 0xFF},
+  {CV_MAST_TABLE + 20, 0xFF},                                         //  Mast aspect 10: unused, every head keeps its aspect
+  {CV_MAST_TABLE + 21, 0xFF},
+  {CV_MAST_TABLE + 22, 0xFF},                                         //  Mast aspect 11: unused, every head keeps its aspect
+  {CV_MAST_TABLE + 23, 0xFF},
+  {CV_MAST_TABLE + 24, 0xFF},                                         //  Mast aspect 12: unused, every head keeps its aspect
+  {CV_MAST_TABLE + 25, 0xFF},
+  {CV_MAST_TABLE + 26, 0xFF},                                         //  Mast aspect 13: unused, every head keeps its aspect
+  {CV_MAST_TABLE + 27, 0xFF},
+  {CV_MAST_TABLE + 28, 0xFF},                                         //  Mast aspect 14: unused, every head keeps its aspect
+  {CV_MAST_TABLE + 29, 0xFF},
+  {CV_MAST_TABLE + 30, 0xFF},                                         //  Mast aspect 15: unused, every head keeps its aspect
+  {CV_MAST_TABLE + 31, 0xFF},
 };
 
-// The following four lists define the intensities of the colors at different points along the animation. They scale from 0 to 63.
-const byte bypassColor[] = {3, 11, 24, 32, 25, 8, 3, 0};
-const byte leaveColor[] = {32, 29,  25,  19,  14,  5, 17,  24,  19,  8, 6, 0};
-const byte stopAtEnergized[] = {3, 7, 10, 14, 18, 25, 30, 32, 32, 26, 13, 19, 25, 29, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 24, 19, 22, 29, 32};
-const byte stopAtNonEnergized[] = {1, 2, 6, 16, 19, 22, 27, 32, 32, 32, 32, 32, 32, 32, 32, 32, 29, 26, 21, 14, 10, 3, 3, 5, 7, 11, 14, 18, 22, 28, 32, 32, 32, 32, 
-                                                                                              32, 32, 32, 32, 32, 32, 32, 29, 27, 24, 21, 16, 14, 18, 21, 25, 28, 32};
+////////////////////////////////////
+//  ANIMATION CURVES AND PLAYBACK  //
+////////////////////////////////////
+
+// Each curve is a list of keyframes, one per ANIMATE_DELAY_TIME, giving the intensity of the color being animated ( 0 to MAX_CURVE_LEVEL ).
+// Playback is timed from the start of the curve and interpolates between keyframes, redrawing every ANIMATE_FRAME_TIME ( Config.h ).
+// They are kept in flash and run-length encoded: the low 6 bits of a key hold the level and the top 2 bits how many extra frames it is held for.
+
+#define KEY(level, frames)  (byte)( ( ( (frames) - 1 ) << 6 ) | (level) )   //  Holds a level for 1 to 4 frames
+#define KEY_LEVEL(key)      ( (key) & 0x3F )
+#define KEY_REPEATS(key)    ( (key) >> 6 )
+#define MAX_CURVE_LEVEL     32                                        //  Highest intensity used in the animation curves
+
+const byte leaveColorKeys[] PROGMEM = {32, 29, 25, 19, 14, 5, 17, 24, 19, 8, 6, 0};
+const byte bypassColorKeys[] PROGMEM = {3, 11, 24, 32, 25, 8, 3, 0};
+const byte stopAtEnergizedKeys[] PROGMEM = {3, 7, 10, 14, 18, 25, 30, KEY(32,2), 26, 13, 19, 25, 29, KEY(32,4), KEY(32,4), KEY(32,4), KEY(32,3), 24, 19, 22, 29, 32};
+const byte stopAtNonEnergizedKeys[] PROGMEM = {1, 2, 6, 16, 19, 22, 27, KEY(32,4), KEY(32,4), 32, 29, 26, 21, 14, 10, KEY(3,2), 5, 7, 11, 14, 18, 22, 28, KEY(32,4), KEY(32,4), 
+                                                                                              KEY(32,3), 29, 27, 24, 21, 16, 14, 18, 21, 25, 28, 32};
+
+#define CURVE_LEAVE               0                                   //  Vane leaves the lens the head was showing
+#define CURVE_BYPASS              1                                   //  Vane swings past a lens on its way to the target
+#define CURVE_STOP_ENERGIZED      2                                   //  Vane swings in and bounces to rest on an energized lens
+#define CURVE_STOP_NON_ENERGIZED  3                                   //  Vane drops back and bounces to rest on the de-energized (red) lens
+
+typedef struct
+{
+  const byte *  keys;                                                 //  Keyframes in flash
+  byte          numKeys;                                              //  Number of bytes in keys
+  byte          endState;                                             //  headStatus when the curve is done: STATE_ANIMATE_BLACK to move on to the
+} AnimationCurve;                                                     //  next lens, STATE_IDLE to settle on the color that was animated
+
+const AnimationCurve animationCurves[] PROGMEM =
+{
+  {leaveColorKeys,          sizeof(leaveColorKeys),          STATE_ANIMATE_BLACK},
+  {bypassColorKeys,         sizeof(bypassColorKeys),         STATE_ANIMATE_BLACK},
+  {stopAtEnergizedKeys,     sizeof(stopAtEnergizedKeys),     STATE_IDLE},
+  {stopAtNonEnergizedKeys,  sizeof(stopAtNonEnergizedKeys),  STATE_IDLE},
+};
 
 typedef struct 
 {
@@ -135,35 +270,165 @@ typedef struct
   byte    blu;
 } ColorInfo;
 
-ColorInfo colorCache[ NUM_COLORS ] =
+ColorInfo colorCache[ NUM_COLORS ] =                                  //  LED intensities are loaded from CVs 35-49 in setup()
 {
-  {0, Dcc.getCV(35), Dcc.getCV(36), Dcc.getCV(37)},  // Black
-  {1, Dcc.getCV(38), Dcc.getCV(39), Dcc.getCV(40)},  // Red
-  {0, Dcc.getCV(41), Dcc.getCV(42), Dcc.getCV(43)},  // Green
-  {2, Dcc.getCV(44), Dcc.getCV(45), Dcc.getCV(46)},  // Yellow
-  {3, Dcc.getCV(47), Dcc.getCV(48), Dcc.getCV(49)},  // Lunar
+  {0},  // Black
+  {1},  // Red
+  {0},  // Green
+  {2},  // Yellow
+  {3},  // Lunar
 };
 
 const byte vaneOrder[] = {GREEN, RED, YELLOW, LUNAR};
 
-typedef struct                                                      //  headState structure controls the behavior of each head
+const byte lampTestSteps[][3] PROGMEM =                               //  Red, green and blue LED intensities of each lamp test step
 {
-  byte    startColor = RED;                                           //  Color of the signal when command was recieved from DCC system
-  byte    currColor = RED;                                            //  Color of the aspect in animation
-  byte    nextColor = RED;                                            //  Color that is being targeted
-  
-  byte    headStatus = STATE_IDLE;
-  byte    effect = NO_EFFECT;                                         
+  { 0,  0,  0},                                                       //  Off
+  {32,  0,  0},                                                       //  Red LED
+  { 0, 32,  0},                                                       //  Green LED
+  { 0,  0, 32},                                                       //  Blue LED
+  {32, 32, 32},                                                       //  All LEDs
+};
+
+#define LAMP_TEST_STEPS         5
+#define LAMP_TEST_SHORT_FIRST   1                                     //  Steps shown by a short lamp test
+#define LAMP_TEST_SHORT_LAST    3
+
+byte lampTestMode;                                                    //  CV_LAMP_TEST_MODE, read when the lamp test starts
+byte lampTestStep;                                                    //  CV_LAMP_TEST_STEP, read when the lamp test starts
+
+//  Per-head state is packed into one array per field, so a board can drive many heads in little SRAM and the per-head
+//  loop walks contiguous memory. Each head takes 7 bytes:
+//
+//    flags     bits 0-1 headStatus, bit 2 effect, bit 3 scheduled, bit 4 flash lit, bits 5-7 start color
+//    colors    bits 0-3 current color, bits 4-7 next color
+//    deadline  low 16 bits of millis() at which loop() next needs to look at the head
+//    cursor    bits 0-5 keyframe of the current curve on show, bits 6-7 frames of that keyframe already over
+//              ( during the lamp test, the step on show )
+//    frameStart  low 16 bits of millis() at which the frame under the cursor started, or the next curve starts
+
+#define HEAD_STATUS_MASK    0x03
+#define HEAD_EFFECT         0x04
+#define HEAD_SCHEDULED      0x08
+#define HEAD_FLASH_ON       0x10
+#define HEAD_START_SHIFT    5
+
+#define CURSOR_KEY_MASK     0x3F                                      //  Limits a curve to 64 keyframes
+#define CURSOR_REPEAT_SHIFT 6
+
+template< uint8_t HEADS >
+struct HeadTable
+{
+  byte      flags[ HEADS ];
+  byte      colors[ HEADS ];
+  uint16_t  deadline[ HEADS ];
+  byte      cursor[ HEADS ];
+  uint16_t  frameStart[ HEADS ];
+
+  HeadTable()
+  {
+    for(uint8_t i = 0; i < HEADS; i++)                                //  Every head starts idle on red, with no effect
+    {
+      flags[i] = STATE_IDLE | ( RED << HEAD_START_SHIFT );
+      colors[i] = RED | ( RED << 4 );
+      deadline[i] = 0;
+      cursor[i] = 0;
+      frameStart[i] = 0;
+    }
+  }
+
+  byte    headStatus( uint8_t h )                 { return flags[h] & HEAD_STATUS_MASK; }
+  void    setHeadStatus( uint8_t h, byte status ) { flags[h] = ( flags[h] & ~HEAD_STATUS_MASK ) | status; }
+  byte    effect( uint8_t h )                     { return ( flags[h] & HEAD_EFFECT ) ? EFFECT_FLASHING : NO_EFFECT; }
+  void    setEffect( uint8_t h, byte effect )     { setFlag( h, HEAD_EFFECT, effect == EFFECT_FLASHING ); }
+  boolean scheduled( uint8_t h )                  { return flags[h] & HEAD_SCHEDULED; }
+  void    setScheduled( uint8_t h, boolean on )   { setFlag( h, HEAD_SCHEDULED, on ); }
+  boolean flashOn( uint8_t h )                    { return flags[h] & HEAD_FLASH_ON; }
+  void    setFlashOn( uint8_t h, boolean on )     { setFlag( h, HEAD_FLASH_ON, on ); }
+
+  byte    startColor( uint8_t h )                 { return flags[h] >> HEAD_START_SHIFT; }
+  void    setStartColor( uint8_t h, byte color )  { flags[h] = ( flags[h] & ~( 0x07 << HEAD_START_SHIFT ) ) | ( color << HEAD_START_SHIFT ); }
+  byte    currColor( uint8_t h )                  { return colors[h] & 0x0F; }
+  void    setCurrColor( uint8_t h, byte color )   { colors[h] = ( colors[h] & 0xF0 ) | color; }
+  byte    nextColor( uint8_t h )                  { return colors[h] >> 4; }
+  void    setNextColor( uint8_t h, byte color )   { colors[h] = ( colors[h] & 0x0F ) | ( color << 4 ); }
+
+  byte    keyIndex( uint8_t h )                   { return cursor[h] & CURSOR_KEY_MASK; }
+  byte    keyRepeat( uint8_t h )                  { return cursor[h] >> CURSOR_REPEAT_SHIFT; }
+  void    setCursor( uint8_t h, byte key, byte repeat ) { cursor[h] = key | ( repeat << CURSOR_REPEAT_SHIFT ); }
+
+private:
+  void setFlag( uint8_t h, byte flag, boolean on )  { if( on ) flags[h] |= flag; else flags[h] &= ~flag; }
+};
+
+HeadTable< NUM_HEADS > heads;
+
+#include "Output.h"                                                   //  Channel shadow, frame commit and the LED output backend
+
+uint16_t nextHeadDeadline = 0;                                        //  Earliest deadline of all scheduled heads ( low 16 bits of millis() )
+boolean headsScheduled = false;                                       //  Whether any head is scheduled at all
+
+//  Aspect commands from notifyDccSigOutputState() wait here until loop() applies them. Command stations repeat
+//  accessory packets constantly, so a repeat of the aspect a head already has, or is about to get, is dropped,
+//  and a new aspect for a head that is still waiting replaces the old one. Each head is in the ring at most
+//  once, so a ring of NUM_HEADS slots ( rounded up to a power of two ) never overflows. One producer, the
+//  callback, and one consumer, loop().
+//
+//    aspects  bits 0-3 last aspect applied, bits 4-7 aspect waiting in the ring ( ASPECT_NONE if none )
 
-  ColorInfo colorInfo = colorCache[RED];
+#define ASPECT_NONE         0x0F
 
-  int     inputStabilizeCount = 0;
-  long    lastAnimateTime = 0;
-  long    lastFlashTime = 0;
-  int     frame = 0;
-} HeadState;   
+constexpr uint8_t ringSize( uint8_t count, uint8_t size = 1 )        //  Smallest power of two that holds count entries
+{
+  return size >= count ? size : ringSize( count, size * 2 );
+}
 
-HeadState headStates[3];
+template< uint8_t HEADS >
+struct AspectQueue
+{
+  static constexpr uint8_t SIZE = ringSize( HEADS );
+
+  byte          ring[ SIZE ];                                         //  Head indexes, oldest first
+  volatile byte in;                                                   //  Free-running, written only by push()
+  volatile byte out;                                                  //  Free-running, written only by pop()
+  byte          aspects[ HEADS ];
+
+  AspectQueue() : in( 0 ), out( 0 )
+  {
+    memset( aspects, ( ASPECT_NONE << 4 ) | ASPECT_NONE, sizeof( aspects ) );
+  }
+
+  boolean push( uint8_t h, byte aspect )                              //  Returns false if the aspect was a repeat and was dropped
+  {
+    byte waiting = aspects[h] >> 4;
+    if( aspect == ( waiting == ASPECT_NONE ? ( aspects[h] & 0x0F ) : waiting ) )
+    {
+      return false;
+    }
+    aspects[h] = ( aspects[h] & 0x0F ) | ( aspect << 4 );
+    if( waiting == ASPECT_NONE )
+    {
+      ring[ in & ( SIZE - 1 ) ] = h;
+      in = in + 1;
+    }
+    return true;
+  }
+
+  boolean pop( uint8_t & h, byte & aspect )                           //  Takes the oldest waiting head and marks its aspect applied
+  {
+    if( out == in )
+    {
+      return false;
+    }
+    h = ring[ out & ( SIZE - 1 ) ];
+    aspect = aspects[h] >> 4;
+    aspects[h] = ( ASPECT_NONE << 4 ) | aspect;
+    out = out + 1;
+    return true;
+  }
+};
+
+AspectQueue< NUM_HEADS > aspectQueue;
 
 typedef struct
 {
@@ -184,3 +449,21 @@ AspectInfo aspectTable[ NUM_ASPECTS ] =
   {LUNAR,   ON,   EFFECT_FLASHING},                                   // Aspect 7 is lens 3 (lunar) with a flashing (always) vane (if enabled) effect
   {BLACK,   OFF,  NO_EFFECT}                                          // Aspect 8 is dark
 };
+
+////////////////////////
+//  CHECK RAM BUDGET  //
+////////////////////////
+
+//  The ATtiny841 has 512 bytes of SRAM. About half is left to NmraDcc, SoftPWM, the Arduino core and the stack, so the tables
+//  above must fit in SKETCH_RAM_BUDGET ( BoardDefine.h ). A capture ring for that board has to be made small to fit.
+
+#ifdef SKETCH_RAM_BUDGET
+#ifdef DCC_CAPTURE
+#define CAPTURE_RAM   sizeof( captureRing )
+#else
+#define CAPTURE_RAM   0
+#endif
+static_assert( sizeof( cvStore ) + sizeof( cvDirty ) + sizeof( perfCounters ) + sizeof( colorCache ) + sizeof( heads ) +
+               sizeof( outputLevels ) + sizeof( outputDirty ) + sizeof( aspectQueue ) + sizeof( aspectTable ) + CAPTURE_RAM
+               <= SKETCH_RAM_BUDGET, "Sketch tables do not fit the RAM budget of this board" );
+#endif
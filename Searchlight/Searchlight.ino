@@ -50,8 +50,8 @@ Special thanks to Mike Weber, who graciously provided his wonderful
 //  INCLUDE REQUIRED HEADER FILES  //
 /////////////////////////////////////
 
-#include "BoardDefine.h"                                              //  Include the header file that defines the pin numbers, etc.
 #include "Config.h"                                                   //  Include the configuration header file
+#include "BoardDefine.h"                                              //  Include the header file that defines the pin numbers, etc.
 #include "Searchlight.h"                                              //  Include the Searchlight header file
 
 ///////////////////////////
@@ -62,11 +62,22 @@ void DccBackEndFunc();
 void notifyCVResetFactoryDefault();
 void notifyCVChange( uint16_t, uint8_t );
 void notifyDccMsg( DCC_MSG * Msg );
-void leaveColorFunc( uint8_t, byte );
-void bypassColorFunc( uint8_t, byte );
-void stopAtEnergizedFunc( uint8_t, byte );
-void stopAtDeEnergizedFunc( uint8_t, byte=RED );
-void setSoftPWMValues( uint8_t, uint8_t, uint8_t, uint8_t, boolean );
+void playCurve( uint8_t, byte, byte );
+void setHeadValues( uint8_t, uint8_t, uint8_t, uint8_t );
+void scheduleHead( uint8_t, uint16_t );
+void applyAspects();
+void queueMastAspect( uint8_t );
+void startLampTest();
+void lampTestHead( uint8_t );
+void endLampTest( uint8_t );
+void countPerf( uint8_t );
+void measureLoopTime();
+void countLateness( uint16_t );
+void countReset();
+void animateHead( uint8_t );
+void flashHead( uint8_t );
+void setHeadLevel( uint8_t, byte, uint8_t );
+uint8_t scaleLevel( uint8_t, uint8_t );
 
 /////////////
 //  SETUP  //
@@ -82,6 +93,8 @@ void setup()
   pinMode(PROG_JUMPER_PIN, INPUT_PULLUP);                             //  Set the Programming jumper input as an input and enable its pullup resistor
   #endif
   
+  loadCVs();                                                          //  Read every stored CV into RAM in one pass, before anything asks for one
+
   Dcc.pin( 0, DCC_READ_PIN, 0 );                                      //  Setup which External Interrupt, the Pin it's associated with, and
                                                                       //  that we're using and enable the Pull-Up
 
@@ -96,33 +109,31 @@ void setup()
   Serial.println(baseAddress);
   #endif
 
-  #ifndef SERIAL_DEBUG
-  Palatis::SoftPWM.begin(120);                                         //  Begin soft PWM with 60hz pwm frequency
-  #endif
+  outputBegin();                                                      //  Set up the LED output backend selected in Config.h
+  redrawOutputs();                                                    //  Drive every LED from the first commit, even the ones that start dark
 
   #ifdef RESET_CVS_ON_POWER
   notifyCVResetFactoryDefault();                                      //  Force Restore to factory defaults whenever decoder is restarted (enable in config)
   #endif
 
+  countReset();                                                       //  Count this start for the performance counter CVs
+
   baseAddress = Dcc.getAddr();                                        //  Preload the decoder address
   commonPole = Dcc.getCV(55);                                         //  Preload commonpole variable
+  mastMode = ( Dcc.getCV( CV_MAST_MODE ) == 1 );                      //  Preload mast mode, only 1 turns it on
 
-#ifndef SERIAL_DEBUG
-  for(int i = 0; i < NUM_HEADS ; i++) 
-  { 
-    setSoftPWMValues( i, 0, 0, 0, 0 );
-    delay(500);
-    setSoftPWMValues( i, 32, 0, 0, 0 );
-    delay(500);
-    setSoftPWMValues( i, 0, 32, 0, 0 );
-    delay(500);
-    setSoftPWMValues( i, 0, 0, 32, 0 );
-    delay(500);
-    setSoftPWMValues( i, 32, 32, 32, 0 );
-    delay(500);
-    setSoftPWMValues( i, colorCache[1].red, colorCache[1].grn, colorCache[1].blu, 0 );
+  #ifdef DCC_CAPTURE
+  setCaptureMode( Dcc.getCV( CV_CAPTURE_MODE ) );                     //  A capture left running carries on from power up
+  #endif
+
+  for(uint8_t color = 0; color < NUM_COLORS; color++)                 //  Preload the LED intensities of each color from CVs 35-49
+  {
+    colorCache[color].red = Dcc.getCV( 35 + ( color * 3 ) );
+    colorCache[color].grn = Dcc.getCV( 36 + ( color * 3 ) );
+    colorCache[color].blu = Dcc.getCV( 37 + ( color * 3 ) );
   }
-#endif
+
+  startLampTest();                                                    //  Runs from loop(), so DCC packets are heard from the start
 }
 
 /////////////////
@@ -131,105 +142,278 @@ void setup()
 
 void loop() 
 {
+  measureLoopTime();                                                  //  Time since the last pass, for the performance counter CVs
   Dcc.process();                                                      //  Read the DCC bus and process the signal. Needs to be called frequently.
   DccBackEndFunc();                                                   //  Runs all DCC Back-end operations ( separate function keeps code clean )
+  flushCVs();                                                         //  Write back one changed CV if the EEPROM is free
+  applyAspects();                                                     //  Start the heads whose aspect changed since the last pass
   
+  uint16_t now = millis();                                            //  Deadlines are kept as the low 16 bits of millis()
+
+  if( !headsScheduled || ( (int16_t)( now - nextHeadDeadline ) < 0 ) ) //  No head is due yet, so spend the time reading the DCC bus
+  {
+    commitOutputs();                                                  //  Levels staged outside the frames, such as the redraw for a new CV 55,
+    return;                                                           //  must not wait for a head to be due. Returns at once if nothing changed
+  }
+  headsScheduled = false;                                             //  Rebuilt below from the heads that are still waiting on something
+
   /////////////////////////////////
   //  VANE SPECIAL EFFECTS CODE  //
   /////////////////////////////////
   
   for(int headIndex = 0; headIndex < NUM_HEADS; headIndex++)          //  For each signal head...
   { 
-    if (headStates[headIndex].inputStabilizeCount < 60)               
-    {                               
-      headStates[headIndex].inputStabilizeCount ++;                   //  Make sure both inputs are stable before executing an animation sequence
+    if( !heads.scheduled(headIndex) )
+    {
+      continue;
     }
-    else
-    {            
-      if( millis() - headStates[headIndex].lastAnimateTime >= ANIMATE_DELAY_TIME ) //  And check if it's time to fire off the next frame of animation (every 20ms)
-      { 
-        if( headStates[headIndex].headStatus == STATE_ANIMATE ) {
-          if( headStates[headIndex].startColor == headStates[headIndex].nextColor )
-          {
-            #ifdef SERIAL_DEBUG
-            Serial.println(": n");
-            #endif 
-            headStates[headIndex].headStatus = STATE_IDLE;
-            headStates[headIndex].currColor = headStates[headIndex].startColor;
-            headStates[headIndex].frame = 0;
-          }
-          
-          // If the signal's starting color does not equal it's target color, if the signal is not in a black animation state, 
-          // and if the current color of the signal is the starting color of the signal...
-          else if( ( headStates[headIndex].startColor != headStates[headIndex].nextColor ) && ( headStates[headIndex].headStatus != STATE_ANIMATE_BLACK )
-                                                                          && ( headStates[headIndex].startColor == headStates[headIndex].currColor ) ) 
-          {                                                                
-            leaveColorFunc( headIndex, headStates[headIndex].startColor );   //  Leave the current color of the signal head (animation)
-          #ifdef SERIAL_DEBUG
-            Serial.println(": l");
-          #endif  
-          }
-        }
-        else if( headStates[headIndex].headStatus == STATE_ANIMATE_BLACK ) // If we're in the middle of an animation transition...
-        {
-          if( abs( colorCache[headStates[headIndex].currColor].vanePos - colorCache[headStates[headIndex].nextColor].vanePos ) == 1 ) 
-          {          // Get vane position for current color                                  // Get vane position for target color           
-            // If the signal is currently one lens away from its target, and the next color is red...
-            if(headStates[headIndex].nextColor == RED)
-            {
-              //  If the next color is RED...
-              stopAtDeEnergizedFunc( headIndex, RED );                        //  ...move to the red aspect, which is deenergized in most setups (safety precaution).
-            #ifdef SERIAL_DEBUG
-              Serial.println(": de");
-            #endif 
-            }
-            else 
-            {
-              //  If the next color is NOT red...
-              stopAtEnergizedFunc( headIndex, headStates[headIndex].nextColor );         //  ...move to the specified color, which is energized in most setups.
-            #ifdef SERIAL_DEBUG
-              Serial.println(": en");
-            #endif 
-            }
-          }
-          else if( ( colorCache[headStates[headIndex].currColor].vanePos - colorCache[headStates[headIndex].nextColor].vanePos ) >= 2 ) 
-          {          // Get vane position for current color                                  // Get vane position for target color 
-            
-            bypassColorFunc( headIndex, vaneOrder[colorCache[headStates[headIndex].currColor].vanePos - 1] );
-                                          // Look up the vane ID that is one less than the current vane
-          #ifdef SERIAL_DEBUG
-            Serial.println(":by");
-          #endif 
-          }
-          else if( ( colorCache[headStates[headIndex].currColor].vanePos - colorCache[headStates[headIndex].nextColor].vanePos ) <= -2 ) 
-          {          // Get vane position for current color                                  // Get vane position for target color 
-            
-            bypassColorFunc( headIndex, vaneOrder[colorCache[headStates[headIndex].currColor].vanePos + 1] );
-                                          // Look up the vane ID that is one less than the current vane
-          #ifdef SERIAL_DEBUG
-            Serial.println(":by");
-          #endif 
-          }
-        }
-      }
+    if( (int16_t)( now - heads.deadline[headIndex] ) < 0 )
+    {
+      scheduleHead( headIndex, heads.deadline[headIndex] );           //  Not due yet, keep it in the running for the next deadline
+      continue;
+    }
+    heads.setScheduled( headIndex, false );
+    countLateness( (uint16_t)( now - heads.deadline[headIndex] ) );
+    if( ( heads.headStatus(headIndex) == STATE_ANIMATE ) || ( heads.headStatus(headIndex) == STATE_ANIMATE_BLACK ) )
+    {
+      animateHead( headIndex );                                       //  Stabilize window is over or the next frame is due
+    }
+    else if( heads.headStatus(headIndex) == STATE_LAMP_TEST )
+    {
+      lampTestHead( headIndex );                                      //  Time for the next lamp test color
+    }
+    else if( heads.effect(headIndex) == EFFECT_FLASHING )
+    {
+      flashHead( headIndex );                                         //  Time to toggle a flashing head
+    }
+  }
+
+  commitOutputs();                                                    //  Show this frame, writing only the channels that changed
+}
+
+/////////////////////////////////
+//  HEAD SCHEDULING FUNCTIONS  //
+/////////////////////////////////
+
+void scheduleHead( uint8_t headIndex, uint16_t deadline )            //  Sets when a head next needs attention from loop(), at most 32 seconds ahead
+{
+  heads.deadline[headIndex] = deadline;
+  heads.setScheduled( headIndex, true );
+  if( !headsScheduled || ( (int16_t)( deadline - nextHeadDeadline ) < 0 ) )
+  {
+    nextHeadDeadline = deadline;
+    headsScheduled = true;
+  }
+}
+
+void applyAspects()                                                  //  Drains the aspect queue filled by notifyDccSigOutputState()
+{
+  uint8_t headIndex;
+  byte aspect;
+  while( aspectQueue.pop( headIndex, aspect ) )
+  {
+    if( heads.headStatus(headIndex) == STATE_LAMP_TEST )
+    {
+      endLampTest( headIndex );                                       //  A command ends the lamp test on that head
+      byte restColor = heads.startColor(headIndex);
+      setHeadValues( headIndex, colorCache[restColor].red, colorCache[restColor].grn, colorCache[restColor].blu );  //  Redraw the resting color, the animation may not
+    }
+    if( heads.headStatus(headIndex) != STATE_ANIMATE_BLACK )
+    {
+      heads.setHeadStatus( headIndex, STATE_ANIMATE );                //  Sets the status to animate toward the new aspect, leaving the lens shown
+    }                                                                 //  A head between lenses moves on from the last lens it reached
+    heads.setCursor( headIndex, 0, 0 );                               //  The curve that was playing may not be the next one to play
+    heads.setNextColor( headIndex, aspectTable[aspect].colorID );     //  Looks up the color number in the aspect table, stores to head info table.
+    heads.setEffect( headIndex, aspectTable[aspect].effect );         //  Looks up the aspect effect and stores it to head info table
+    heads.frameStart[headIndex] = millis() + INPUT_STABILIZE_TIME;    //  Animation runs from the end of the stabilization window
+    scheduleHead( headIndex, heads.frameStart[headIndex] );           //  Start the stabilization window before animating
+  }
+}
+
+void queueMastAspect( uint8_t mastAspect )                            //  Queues the head aspects of one mast table entry, so the heads all start in one pass
+{
+  uint16_t CV = CV_MAST_TABLE + ( mastAspect * MAST_TABLE_CVS );
+  for(uint8_t headIndex = 0; headIndex < MAST_HEADS; headIndex++)
+  {
+    byte aspect = readStoredCV( CV + ( headIndex >> 1 ) );
+    aspect = ( headIndex & 1 ) ? ( aspect >> 4 ) : ( aspect & 0x0F );
+    if( aspect < NUM_ASPECTS )                                        //  MAST_KEEP, or any other nibble past the aspect table, leaves the head alone
+    {
+      aspectQueue.push( headIndex, aspect );                          //  Repeats of a head's current aspect are dropped here, as for single heads
+    }
+  }
+}
+
+//////////////////////////
+//  LAMP TEST FUNCTIONS  //
+//////////////////////////
+
+void startLampTest()                                                  //  Puts the heads in their power-up lamp test, set up by CVs 56 and 57
+{
+  lampTestMode = Dcc.getCV( CV_LAMP_TEST_MODE );
+  lampTestStep = Dcc.getCV( CV_LAMP_TEST_STEP );
+  if( lampTestMode == 0xFF )                                          //  Never set, as on a decoder upgraded from earlier firmware
+  {
+    lampTestMode = 0;
+  }
+  if( lampTestStep == 0xFF )
+  {
+    lampTestStep = LAMP_TEST_DEFAULT_STEP;
+  }
+  for(uint8_t headIndex = 0; headIndex < NUM_HEADS; headIndex++)
+  {
+    if( lampTestStep == 0 )
+    {
+      setHeadValues( headIndex, colorCache[RED].red, colorCache[RED].grn, colorCache[RED].blu );  //  No lamp test, show red straight away
+      continue;
+    }
+    heads.setHeadStatus( headIndex, STATE_LAMP_TEST );
+    heads.setCursor( headIndex, 0, 0 );                               //  Step 0 until the test of this head starts
+    setHeadValues( headIndex, 0, 0, 0 );                              //  Dark until its turn comes
+    if( ( headIndex == 0 ) || ( lampTestMode & LAMP_TEST_CONCURRENT ) )
+    {
+      scheduleHead( headIndex, millis() );
+    }
+  }
+  commitOutputs();
+}
+
+void lampTestHead( uint8_t headIndex )                                //  Shows the next lamp test step of a head, or ends its test
+{
+  byte step = heads.keyIndex(headIndex);
+  if( ( step == 0 ) && ( lampTestMode & LAMP_TEST_SHORT ) )
+  {
+    step = LAMP_TEST_SHORT_FIRST;
+  }
+  if( step > ( ( lampTestMode & LAMP_TEST_SHORT ) ? LAMP_TEST_SHORT_LAST : LAMP_TEST_STEPS - 1 ) )
+  {
+    endLampTest( headIndex );
+    setHeadValues( headIndex, colorCache[RED].red, colorCache[RED].grn, colorCache[RED].blu );  //  Test over, rest at red
+    return;
+  }
+  setHeadValues( headIndex, pgm_read_byte( &lampTestSteps[step][0] ), pgm_read_byte( &lampTestSteps[step][1] ), pgm_read_byte( &lampTestSteps[step][2] ) );
+  heads.setCursor( headIndex, step + 1, 0 );
+  scheduleHead( headIndex, millis() + ( lampTestStep * 10 ) );
+}
+
+void endLampTest( uint8_t headIndex )                                 //  Takes a head out of the lamp test, and hands the turn on to the next head
+{
+  boolean wasTesting = heads.scheduled(headIndex) || ( heads.keyIndex(headIndex) != 0 );
+  heads.setHeadStatus( headIndex, STATE_IDLE );
+  heads.setScheduled( headIndex, false );
+  heads.setCursor( headIndex, 0, 0 );
+  if( !wasTesting || ( lampTestMode & LAMP_TEST_CONCURRENT ) )
+  {
+    return;                                                           //  Heads still waiting for their turn keep waiting
+  }
+  for(uint8_t nextHead = headIndex + 1; nextHead < NUM_HEADS; nextHead++)
+  {
+    if( heads.headStatus(nextHead) == STATE_LAMP_TEST )
+    {
+      scheduleHead( nextHead, millis() );
+      return;
     }
-    //  If the signal is not currently animating, and it's either set to flashing or vane plus flashing mode...
-    if( ( headStates[headIndex].headStatus != STATE_ANIMATE ) && ( headStates[headIndex].headStatus != STATE_ANIMATE_BLACK ) && ( headStates[headIndex].effect == EFFECT_FLASHING ) )
+  }
+}
+
+void animateHead( uint8_t headIndex )                                 //  Runs one step of the vane state machine for a head
+{
+  byte statusBefore = heads.headStatus(headIndex);
+  byte colorBefore = heads.currColor(headIndex);
+
+  if( heads.headStatus(headIndex) == STATE_ANIMATE )
+  {
+    if( heads.startColor(headIndex) == heads.nextColor(headIndex) )
     {
-      if( ( millis() - headStates[headIndex].lastAnimateTime ) > FLASH_PULSE_DELAY ) 
+      #ifdef SERIAL_DEBUG
+      Serial.println(": n");
+      #endif 
+      heads.setHeadStatus( headIndex, STATE_IDLE );
+      heads.setCurrColor( headIndex, heads.startColor(headIndex) );
+      heads.setCursor( headIndex, 0, 0 );
+      setHeadLevel( headIndex, heads.startColor(headIndex), MAX_CURVE_LEVEL );  //  Back to full brightness, the head may have been part way through leaving
+    }
+    
+    // If the signal's starting color does not equal it's target color, if the signal is not in a black animation state, 
+    // and if the current color of the signal is the starting color of the signal...
+    else if( ( heads.startColor(headIndex) != heads.nextColor(headIndex) ) && ( heads.headStatus(headIndex) != STATE_ANIMATE_BLACK )
+                                                                    && ( heads.startColor(headIndex) == heads.currColor(headIndex) ) ) 
+    {                                                                
+      playCurve( headIndex, CURVE_LEAVE, heads.startColor(headIndex) );   //  Leave the current color of the signal head (animation)
+    #ifdef SERIAL_DEBUG
+      Serial.println(": l");
+    #endif  
+    }
+  }
+  else if( heads.headStatus(headIndex) == STATE_ANIMATE_BLACK ) // If we're in the middle of an animation transition...
+  {
+    if( abs( colorCache[heads.currColor(headIndex)].vanePos - colorCache[heads.nextColor(headIndex)].vanePos ) <= 1 ) 
+    {          // Get vane position for current color                                  // Get vane position for target color           
+      // If the signal is currently one lens away from its target, or on the same vane position ( dark shares green's, and a head
+      // retargeted between lenses may be sent back to the last one it reached ), and the next color is red...
+      if(heads.nextColor(headIndex) == RED)
       {
-        headStates[headIndex].lastAnimateTime = millis();
+        //  If the next color is RED...
+        playCurve( headIndex, CURVE_STOP_NON_ENERGIZED, RED );          //  ...move to the red aspect, which is deenergized in most setups (safety precaution).
+      #ifdef SERIAL_DEBUG
+        Serial.println(": de");
+      #endif 
       }
-      if( ( millis() - headStates[headIndex].lastAnimateTime ) <= ( FLASH_PULSE_DELAY / 2 ) )
+      else 
       {
-        setSoftPWMValues( headIndex, colorCache[headStates[headIndex].currColor].red, colorCache[headStates[headIndex].currColor].grn, colorCache[headStates[headIndex].currColor].blu, 0 );
+        //  If the next color is NOT red...
+        playCurve( headIndex, CURVE_STOP_ENERGIZED, heads.nextColor(headIndex) );   //  ...move to the specified color, which is energized in most setups.
+      #ifdef SERIAL_DEBUG
+        Serial.println(": en");
+      #endif 
       }
-      else
-      {
-        setSoftPWMValues( headIndex, 0, 0, 0, 0 );
-      }   
     }
+    else if( ( colorCache[heads.currColor(headIndex)].vanePos - colorCache[heads.nextColor(headIndex)].vanePos ) >= 2 ) 
+    {          // Get vane position for current color                                  // Get vane position for target color 
+      
+      playCurve( headIndex, CURVE_BYPASS, vaneOrder[colorCache[heads.currColor(headIndex)].vanePos - 1] );
+                                    // Look up the vane ID that is one less than the current vane
+    #ifdef SERIAL_DEBUG
+      Serial.println(":by");
+    #endif 
+    }
+    else if( ( colorCache[heads.currColor(headIndex)].vanePos - colorCache[heads.nextColor(headIndex)].vanePos ) <= -2 ) 
+    {          // Get vane position for current color                                  // Get vane position for target color 
+      
+      playCurve( headIndex, CURVE_BYPASS, vaneOrder[colorCache[heads.currColor(headIndex)].vanePos + 1] );
+                                    // Look up the vane ID that is one less than the current vane
+    #ifdef SERIAL_DEBUG
+      Serial.println(":by");
+    #endif 
+    }
+  }
+
+  if( heads.headStatus(headIndex) == STATE_IDLE )                //  Animation is over...
+  {
+    if( heads.effect(headIndex) == EFFECT_FLASHING )
+    {
+      heads.setFlashOn( headIndex, false );
+      scheduleHead( headIndex, millis() );                            //  ...so start flashing straight away if the aspect calls for it
+    }
+  }
+  else if( !heads.scheduled(headIndex) && ( ( heads.headStatus(headIndex) != statusBefore ) || ( heads.currColor(headIndex) != colorBefore ) ) )
+  {
+    scheduleHead( headIndex, millis() );                              //  A stage finished without drawing a frame, start the next one on the next pass
+  }
+}
+
+void flashHead( uint8_t headIndex )                                   //  Toggles a flashing head between its color and dark
+{
+  heads.setFlashOn( headIndex, !heads.flashOn(headIndex) );
+  if( heads.flashOn(headIndex) )
+  {
+    setHeadValues( headIndex, colorCache[heads.currColor(headIndex)].red, colorCache[heads.currColor(headIndex)].grn, colorCache[heads.currColor(headIndex)].blu );
+  }
+  else
+  {
+    setHeadValues( headIndex, 0, 0, 0 );
   }
+  scheduleHead( headIndex, millis() + ( FLASH_PULSE_DELAY / 2 ) );
 }
 
 ///////////////////////////////////////////
@@ -245,29 +429,41 @@ void notifyDccSigOutputState( uint16_t Addr, uint8_t State )          //  Notifi
   Serial.println( State );                                            //  Print aspect number from incoming packet
   #endif
   
-  if( ( Addr < baseAddress ) || ( Addr >= ( baseAddress + NUM_HEADS ) ) )     //  Make sure we're only looking at our addresses
+  if( mastMode && ( Addr == baseAddress ) )                           //  In mast mode the base address sets the whole mast at once
+  {
+    if( State >= MAST_ASPECTS )
+    {
+      countPerf( PERF_PACKETS_REJECTED );
+      return;
+    }
+    countPerf( PERF_PACKETS_ACCEPTED );
+    queueMastAspect( State );
+    return;
+  }
+
+  if( ( Addr < ( baseAddress + ( mastMode ? MAST_HEADS : 0 ) ) ) || ( Addr >= ( baseAddress + NUM_HEADS ) ) )  //  Make sure we're only looking at our addresses
   {
     #ifdef  SERIAL_DEBUG
     //Serial.println( F( "notifyDccSigState: Address out of range" ) );
     #endif
     
+    countPerf( PERF_PACKETS_REJECTED );
     return;
   }
-  if( State > NUM_ASPECTS )                                           //  Check we've got a valid Aspect
+  if( State >= NUM_ASPECTS )                                          //  Check we've got a valid Aspect
   {
     #ifdef  SERIAL_DEBUG
     //Serial.println( F( "notifyDccSigState: State out of range" ) );
     #endif
     
+    countPerf( PERF_PACKETS_REJECTED );
     return;
   }
+  countPerf( PERF_PACKETS_ACCEPTED );
 
   uint8_t headIndex = Addr - baseAddress ;                            //  Determine which head we're talking about (0, 1, 2, ...)
  
-  headStates[headIndex].headStatus = STATE_ANIMATE;                   //  Sets the status to idle (not dimming or brightening)
-  headStates[headIndex].nextColor = aspectTable[State].colorID;       //  Looks up the color number in the aspect table, stores to head info table.
-  headStates[headIndex].effect = aspectTable[State].effect;           //  Looks up the aspect effect and stores it to head info table
-  headStates[headIndex].inputStabilizeCount = 0;                      //  Reset the stabilization timer
+  aspectQueue.push( headIndex, State );                               //  Queue it for loop(), repeats of the current aspect are dropped here
 
   #ifdef SERIAL_DEBUG
   Serial.print( F( "notifyDccSigState: Index: " ) );
@@ -275,13 +471,23 @@ void notifyDccSigOutputState( uint16_t Addr, uint8_t State )          //  Notifi
   #endif
 
   #ifdef LIGHT_DEBUG
-  setSoftPWMValues( headIndex, colorCache[headStates[headIndex].nextColor].red, colorCache[headStates[headIndex].nextColor].grn, colorCache[headStates[headIndex].nextColor].blu ); 
+  byte debugColor = aspectTable[State].colorID;                       //  The head table isn't updated until loop() drains the queue
+  setHeadValues( headIndex, colorCache[debugColor].red, colorCache[debugColor].grn, colorCache[debugColor].blu );
   #endif
 }
 
-#if defined( NOTIFY_DCC_MSG ) && defined( SERIAL_DEBUG )                                            
-void notifyDccMsg( DCC_MSG * Msg )                                    //  Prints all DCC packets to serial line (enable in Config.h)
+void notifyDccMsg( DCC_MSG * Msg )                                    //  Called for every DCC packet received
 {
+  if( packetsThisSecond != 0xFFFF )
+  {
+    packetsThisSecond++;                                              //  Published each second by measureLoopTime()
+  }
+
+#ifdef DCC_CAPTURE
+  capturePacket( Msg );                                               //  Keep the packet in the capture ring (enable in Config.h)
+#endif
+
+#if defined( NOTIFY_DCC_MSG ) && defined( SERIAL_DEBUG )              //  Prints all DCC packets to serial line (enable in Config.h)
   Serial.print( F( "notifyDccMsg: " ) );
   for( uint8_t i = 0; i < Msg->Size; i++ )
   {
@@ -289,8 +495,8 @@ void notifyDccMsg( DCC_MSG * Msg )                                    //  Prints
     Serial.write( ' ' );
   }
   Serial.println();
-}
 #endif
+}
 
 /////////////////////////////////////////////////////////////////////////////
 //  DCC BACKEND - RUNS EVERY TIME THE LOOP HAPPENS (FOR CODE CLEANLINESS)  //
@@ -302,25 +508,27 @@ void DccBackEndFunc()
   //  RESET ALL CV TRIGGER  //
   ////////////////////////////
 
-  if ( FactoryDefaultCVIndex && Dcc.isSetCVReady()) 
-  {
-    FactoryDefaultCVIndex--; // Decrement first as initially it is the size of the array
-    Dcc.setCV( FactoryDefaultCVs[FactoryDefaultCVIndex].CV, FactoryDefaultCVs[FactoryDefaultCVIndex].Value);
-    #ifdef SERIAL_DEBUG
-    //Serial.print(F("FactoryDefault CV: "));
-    //Serial.print( FactoryDefaultCVs[FactoryDefaultCVIndex].CV );
-    //Serial.print(F("  Value: "));
-    //Serial.println( FactoryDefaultCVs[FactoryDefaultCVIndex].Value );
-    #endif
-
-    if(FactoryDefaultCVIndex == 0)
-    {    
-      baseAddress = Dcc.getAddr();
+  if ( FactoryDefaultCVIndex )                                        //  The CV store takes every default at once, and only the
+  {                                                                   //  CVs that differ are written to EEPROM, in the background
+    while( FactoryDefaultCVIndex )
+    {
+      FactoryDefaultCVIndex--; // Decrement first as initially it is the size of the array
+      CVPair defaultCV;
+      memcpy_P( &defaultCV, &FactoryDefaultCVs[FactoryDefaultCVIndex], sizeof( CVPair ) );
+      Dcc.setCV( defaultCV.CV, defaultCV.Value );
       #ifdef SERIAL_DEBUG
-      //Serial.print(F("Base Address: "));
-      //Serial.println(baseAddress);
+      //Serial.print(F("FactoryDefault CV: "));
+      //Serial.print( defaultCV.CV );
+      //Serial.print(F("  Value: "));
+      //Serial.println( defaultCV.Value );
       #endif
     }
+
+    baseAddress = Dcc.getAddr();
+    #ifdef SERIAL_DEBUG
+    //Serial.print(F("Base Address: "));
+    //Serial.println(baseAddress);
+    #endif
   }
 
   ///////////////////////////
@@ -392,7 +600,16 @@ void notifyCVChange( uint16_t CV, uint8_t Value )
       break;
     case 55:
       commonPole = Value;
+      redrawOutputs();                                                //  The pin level of every LED changes with the polarity
+      break;
+    case CV_MAST_MODE:
+      mastMode = ( Value == 1 );
+      break;
+    #ifdef DCC_CAPTURE
+    case CV_CAPTURE_MODE:
+      setCaptureMode( Value );
       break;
+    #endif
   }
   if( ( CV >= 35 ) && ( CV <= 49 ) )
   {
@@ -437,93 +654,218 @@ void notifyDccAccOutputAddrSet( uint16_t OutputAddr )
   AddrSetMode = ADDR_SET_DONE;
 }
 
-/////////////////////////////////
-//  SOFT PWM SETTING FUNCTION  //
-/////////////////////////////////
+/////////////////////////////////////
+//  PERFORMANCE COUNTER FUNCTIONS  //
+/////////////////////////////////////
 
-void setSoftPWMValues( uint8_t headIndex, uint8_t redVal, uint8_t grnVal, uint8_t bluVal, boolean updateStored )  //  Sets the PWM values of each LED in a certain head
-{       
-  //  Functions that set the soft PWM values based on the requested value and the common pole variable                                                         
-  Palatis::SoftPWM.set(   headIndex * 3      , (uint8_t) abs( redVal - ( 32 * commonPole ) ) );
-  Palatis::SoftPWM.set( ( headIndex * 3 ) + 1, (uint8_t) abs( grnVal - ( 32 * commonPole ) ) );
-  Palatis::SoftPWM.set( ( headIndex * 3 ) + 2, (uint8_t) abs( bluVal - ( 32 * commonPole ) ) );
-  
-  //  Update the head states with the current values of the LEDs
-  if(updateStored) {
-    headStates[headIndex].colorInfo.red = redVal;
-    headStates[headIndex].colorInfo.grn = grnVal;
-    headStates[headIndex].colorInfo.blu = bluVal;
+void countPerf( uint8_t counter )                                     //  Adds one to a counter, stopping at 65535
+{
+  if( perfCounters[counter] != 0xFFFF )
+  {
+    perfCounters[counter]++;
   }
 }
 
-/////////////////////////////////
-//  COLOR ANIMATION FUNCTIONS  //
-/////////////////////////////////
+void measureLoopTime()                                                //  Updates the worst-case and average time between passes of loop(), and
+{                                                                     //  the packets received per second
+  uint16_t now = millis();
+  if( (uint16_t)( now - packetSecondStart ) >= 1000 )                 //  Rolled from loop(), so a bus gone quiet reads 0 rather than the last
+  {                                                                   //  busy second
+    perfCounters[PERF_PACKETS_PER_SEC] = packetsThisSecond;           //  Publish the count for the second just finished
+    packetsThisSecond = 0;
+    packetSecondStart = now;
+  }
+
+  uint32_t start = micros();
+  if( lastLoopStart )
+  {
+    uint32_t elapsed = start - lastLoopStart;
+    uint16_t sample = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+    if( sample > perfCounters[PERF_LOOP_MAX] )
+    {
+      perfCounters[PERF_LOOP_MAX] = sample;
+    }
+    loopTimeAvg16 += sample - ( loopTimeAvg16 >> 4 );                 //  Exponential average over about 16 passes
+    perfCounters[PERF_LOOP_AVG] = loopTimeAvg16 >> 4;
+  }
+  lastLoopStart = start;
+}
 
-void leaveColorFunc( uint8_t headIndex, byte colorToLeave )
+void countLateness( uint16_t lateness )                               //  Counts a head serviced after its deadline (ms)
 {
-  if(headStates[headIndex].frame < 12)
+  if( lateness >= ANIMATE_DELAY_TIME )
   {
-    setSoftPWMValues( headIndex, (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToLeave].red / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToLeave].grn / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToLeave].blu / 32, 1 );
-    headStates[headIndex].frame ++;
-    headStates[headIndex].lastAnimateTime = millis();
-    return;
+    countPerf( PERF_FRAMES_DROPPED );
+  }
+  else if( lateness >= FRAME_LATE_TIME )
+  {
+    countPerf( PERF_FRAMES_LATE );
   }
-  headStates[headIndex].headStatus = STATE_ANIMATE_BLACK;
-  headStates[headIndex].currColor = colorToLeave;
-  headStates[headIndex].frame = 0;
 }
 
-void bypassColorFunc( uint8_t headIndex, byte colorToPass) 
+uint8_t notifyCVRead( uint16_t CV )                                   //  Serves the performance counters and capture ring, every other CV comes from the CV store
 {
-  if(headStates[headIndex].frame < 8) 
+  if( ( CV >= CV_PERF_FIRST ) && ( CV < CV_PERF_RESETS_LSB ) )
   {
-    setSoftPWMValues( headIndex, (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToPass].red / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToPass].grn / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToPass].blu / 32, 1 );
-    headStates[headIndex].frame ++;
-    headStates[headIndex].lastAnimateTime = millis();
-    return;
+    uint16_t value = perfCounters[ ( CV - CV_PERF_FIRST ) >> 1 ];
+    return ( CV & 1 ) ? value >> 8 : value & 0xFF;
+  }
+  #ifdef DCC_CAPTURE
+  if( isCaptureCV( CV ) )
+  {
+    return readCaptureCV( CV );
   }
-  headStates[headIndex].headStatus = STATE_ANIMATE_BLACK;
-  headStates[headIndex].currColor = colorToPass;
-  headStates[headIndex].frame = 0;
+  #endif
+  return readStoredCV( CV );
 }
 
-void stopAtEnergizedFunc( uint8_t headIndex, byte colorToStopAt ) 
+uint8_t notifyCVWrite( uint16_t CV, uint8_t Value )                   //  Takes every CV write into the CV store, never waiting for EEPROM
 {
-  if(headStates[headIndex].frame < 33) 
+  #ifdef DCC_CAPTURE
+  if( isCaptureCV( CV ) )
   {
-    setSoftPWMValues( headIndex, (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToStopAt].red / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToStopAt].grn / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToStopAt].blu / 32, 1 );
-    headStates[headIndex].frame ++;
-    headStates[headIndex].lastAnimateTime = millis();
-    return;
+    if( CV == CV_CAPTURE_PAGE )
+    {
+      capturePage = Value;                                            //  Only the page select is writable, and it is never stored
+    }
+    return readCaptureCV( CV );
+  }
+  #endif
+  if( writeStoredCV( CV, Value ) )
+  {
+    notifyCVChange( CV, Value );                                      //  The library leaves this to us once notifyCVWrite() is defined
   }
-  headStates[headIndex].headStatus = STATE_IDLE;
-  headStates[headIndex].startColor = colorToStopAt;
-  headStates[headIndex].currColor = colorToStopAt;
-  headStates[headIndex].nextColor = colorToStopAt;
-  headStates[headIndex].frame = 0;
+  return readStoredCV( CV );
+}
+
+uint8_t notifyIsSetCVReady()                                          //  The CV store can always take another write
+{
+  return 1;
 }
 
-void stopAtDeEnergizedFunc( uint8_t headIndex, byte colorToStopAt ) 
+uint8_t notifyCVValid( uint16_t CV, uint8_t Writable )                //  Makes the performance counter and capture CVs read-only, as well as
+                                                                      //  CVs 7 and 8, which the library's own check protects
 {
-  if(headStates[headIndex].frame < 52) 
+  if( ( CV >= CV_PERF_FIRST ) && ( CV <= CV_PERF_LAST ) )
   {
-    setSoftPWMValues( headIndex, (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToStopAt].red / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToStopAt].grn / 32, 
-                                  (uint8_t) bypassColor[headStates[headIndex].frame] * colorCache[colorToStopAt].blu / 32, 1 );
-    headStates[headIndex].frame ++;
-    headStates[headIndex].lastAnimateTime = millis();
-    return;
+    return !Writable;
+  }
+  #ifdef DCC_CAPTURE
+  if( isCaptureCV( CV ) && ( CV != CV_CAPTURE_PAGE ) )
+  {
+    return !Writable;
+  }
+  #endif
+  return ( CV <= E2END ) && !( Writable && ( ( CV == CV_VERSION_ID ) || ( CV == CV_MANUFACTURER_ID ) ) );  //  The library's own rule for the rest
+}
+
+void countReset()                                                     //  Adds one to the start count kept in EEPROM
+{
+  uint16_t resets = ( Dcc.getCV( CV_PERF_RESETS_MSB ) << 8 ) | Dcc.getCV( CV_PERF_RESETS_LSB );
+  resets++;                                                           //  Blank EEPROM reads 65535, so the first start counts as 0
+  Dcc.setCV( CV_PERF_RESETS_LSB, resets & 0xFF );
+  Dcc.setCV( CV_PERF_RESETS_MSB, resets >> 8 );
+}
+
+////////////////////////////////
+//  OUTPUT SETTING FUNCTIONS  //
+////////////////////////////////
+
+void setHeadValues( uint8_t headIndex, uint8_t redVal, uint8_t grnVal, uint8_t bluVal )  //  Stages the output levels of each LED in a certain head
+{       
+  setOutputLevel(   headIndex * 3      , redVal );                    //  How bright each LED should be, the pin backends invert this for
+  setOutputLevel( ( headIndex * 3 ) + 1, grnVal );                    //  common anode heads
+  setOutputLevel( ( headIndex * 3 ) + 2, bluVal );
+}
+
+void setHeadLevel( uint8_t headIndex, byte color, uint8_t level )  //  Sets a head to a color at an animation curve level ( 0 - MAX_CURVE_LEVEL )
+{
+  setHeadValues( headIndex, scaleLevel( colorCache[color].red, level ), scaleLevel( colorCache[color].grn, level ), scaleLevel( colorCache[color].blu, level ) );
+}
+
+uint8_t scaleLevel( uint8_t value, uint8_t level )                    //  Returns value * level / 32 by shift-and-add, as level is at most 6 bits
+{
+  uint16_t scaled = 0;
+  uint16_t shifted = value;
+  while( level )
+  {
+    if( level & 1 )
+    {
+      scaled += shifted;
+    }
+    shifted <<= 1;
+    level >>= 1;
+  }
+  return scaled >> 5;
+}
+
+/////////////////////////////////
+//  COLOR ANIMATION FUNCTIONS  //
+/////////////////////////////////
+
+void playCurve( uint8_t headIndex, byte curveID, byte color )        //  Draws an animation curve in the given color at the current time, or
+{                                                                     //  applies the curve's end state once all of its frames are over
+  AnimationCurve curve;
+  memcpy_P( &curve, &animationCurves[curveID], sizeof(AnimationCurve) );
+
+  uint16_t now = millis();
+  uint16_t elapsed = now - heads.frameStart[headIndex];               //  Time into the keyframe under the cursor
+  if( (int16_t)elapsed < 0 )
+  {
+    elapsed = 0;                                                      //  Called early, draw the frame as it starts
+  }
+  byte keyIndex = heads.keyIndex(headIndex);
+  byte keyRepeat = heads.keyRepeat(headIndex);
+  if( keyIndex >= curve.numKeys )
+  {
+    keyIndex = 0;                                                     //  Cursor left past the end of a longer curve, start this one at its top
+    keyRepeat = 0;
+  }
+  byte key = pgm_read_byte( curve.keys + keyIndex );
+
+  while( elapsed >= ANIMATE_DELAY_TIME )                              //  Skip every keyframe that is already over, so a late loop() catches
+  {                                                                   //  up instead of stretching the animation
+    elapsed -= ANIMATE_DELAY_TIME;
+    heads.frameStart[headIndex] += ANIMATE_DELAY_TIME;
+    if( keyRepeat < KEY_REPEATS(key) )
+    {
+      keyRepeat++;                                                    //  Same level for another frame
+    }
+    else if( ++keyIndex < curve.numKeys )
+    {
+      keyRepeat = 0;
+      key = pgm_read_byte( curve.keys + keyIndex );
+    }
+    else
+    {
+      heads.setHeadStatus( headIndex, curve.endState );               //  Curve is over. frameStart is left at its end, where the next stage begins
+      heads.setCurrColor( headIndex, color );
+      if( curve.endState == STATE_IDLE )                              //  Vane has come to rest on this color
+      {
+        heads.setStartColor( headIndex, color );
+        heads.setNextColor( headIndex, color );
+      }
+      heads.setCursor( headIndex, 0, 0 );
+      return;
+    }
+  }
+  heads.setCursor( headIndex, keyIndex, keyRepeat );
+
+  int16_t level = KEY_LEVEL(key);                                     //  Interpolate toward the level of the next frame, in 8.8 fixed point
+  int16_t nextLevel = level;
+  if( ( keyRepeat == KEY_REPEATS(key) ) && ( keyIndex + 1 < curve.numKeys ) )
+  {
+    nextLevel = KEY_LEVEL( pgm_read_byte( curve.keys + keyIndex + 1 ) );
+  }
+  uint8_t fraction = ( elapsed << 8 ) / ANIMATE_DELAY_TIME;
+  level = ( ( level << 8 ) + ( nextLevel - level ) * fraction + 128 ) >> 8;
+  setHeadLevel( headIndex, color, level );
+
+  uint16_t frameEnd = heads.frameStart[headIndex] + ANIMATE_DELAY_TIME;
+  uint16_t deadline = now + ANIMATE_FRAME_TIME;
+  if( (int16_t)( frameEnd - deadline ) < 0 )
+  {
+    deadline = frameEnd;                                              //  Always draw each keyframe at its own level
   }
-  headStates[headIndex].headStatus = STATE_IDLE;
-  headStates[headIndex].startColor = colorToStopAt;
-  headStates[headIndex].currColor = colorToStopAt;
-  headStates[headIndex].nextColor = colorToStopAt;
-  headStates[headIndex].frame = 0;
+  scheduleHead( headIndex, deadline );
 }